@@ -0,0 +1,51 @@
+#include "bench_common.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<unsigned long long> allocations(0);
+
+// --------------------------------------------------------------------------
+unsigned long long allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------
+std::string jsonString(const std::string& s)
+{
+    std::string res = "\"";
+    for(char c : s)
+    {
+        if(c == '"' || c == '\\') res += '\\';
+        res += c;
+    }
+    return res + "\"";
+}
+
+
+
+// --------------------------------------------------------------------------
+// counting allocator
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if(p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+void* operator new[](std::size_t size, const std::nothrow_t& t) noexcept { return operator new(size, t); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
@@ -0,0 +1,24 @@
+#ifndef BENCH_COMMON_HPP
+#define BENCH_COMMON_HPP
+
+#include <chrono>
+#include <string>
+
+// --------------------------------------------------------------------------
+// heap allocations made since the program start
+// (counted by the replaced global operator new of bench_common.cpp)
+unsigned long long allocationCount();
+
+// --------------------------------------------------------------------------
+// wall clock in nanoseconds
+inline double nowNs()
+{
+    using namespace std::chrono;
+    return (double)duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count();
+}
+
+// --------------------------------------------------------------------------
+// string quoted for json output
+std::string jsonString(const std::string& s);
+
+#endif // BENCH_COMMON_HPP
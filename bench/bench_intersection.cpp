@@ -0,0 +1,288 @@
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "bench_common.hpp"
+#include "maths/math_intersection.hpp"
+#include "physics/physic_entity.hpp"
+
+// microbenchmarks of the math_intersection kernels, printed as json
+// usage : PhysicBenchIntersection [calls per case] [seed]
+
+#define INPUT_COUNT 1024
+
+// --------------------------------------------------------------------------
+// random inputs of the kernels (regenerated from the seed for every case)
+struct Inputs
+{
+    std::mt19937 rng;
+
+    Inputs(unsigned seed) : rng(seed) {}
+
+    float uniform(float a, float b) { return std::uniform_real_distribution<float>(a,b)(rng); }
+    Vec2 point(float range) { return Vec2( uniform(-range,range), uniform(-range,range) ); }
+
+    // rectangle of random size and rotation around a point
+    Polygon rect(float range, bool rotated)
+    {
+        Polygon p( uniform(4.f,30.f), uniform(4.f,30.f) );
+        if(rotated) p.rotate( uniform(0.f,360.f) );
+        p.move( point(range) );
+        return p;
+    }
+
+    // segment parallel to (and sometimes overlapping) the segment a b
+    void parallel(const Vec2& a, const Vec2& b, Vec2& out_a, Vec2& out_b)
+    {
+        Vec2 offset = getNormal(a,b) * ( (rng()%2) ? 0.f : uniform(-2.f,2.f) );
+        Vec2 slide = (b-a) * uniform(-0.5f,0.5f);
+        out_a = a + offset + slide;
+        out_b = b + offset + slide;
+    }
+};
+
+struct BenchResult
+{
+    std::string name;
+    std::string inputs;
+    unsigned long long calls;
+    double nsPerCall;
+    double callsPerSec;
+    double allocsPerCall;
+    double hitRate;
+};
+
+// --------------------------------------------------------------------------
+// call : a kernel call on input i, return true on hit
+// templated on the callable so the calls are inlined (an indirect call costs as much as the small kernels)
+template<typename Call>
+BenchResult run(const std::string& name, const std::string& inputs, unsigned long long calls, const Call& call)
+{
+    // warm up (and first allocations of the inputs)
+    for(unsigned i=0; i<INPUT_COUNT; ++i) call(i);
+
+    unsigned long long hits = 0;
+    unsigned long long allocs = allocationCount();
+    double start = nowNs();
+    for(unsigned long long k=0; k<calls; ++k)
+    {
+        if( call(k % INPUT_COUNT) ) hits++;
+    }
+    double ns = nowNs() - start;
+    allocs = allocationCount() - allocs;
+
+    BenchResult res;
+    res.name = name;
+    res.inputs = inputs;
+    res.calls = calls;
+    res.nsPerCall = ns / calls;
+    res.callsPerSec = ns > 0.0 ? calls * 1e9 / ns : 0.0;
+    res.allocsPerCall = (double)allocs / calls;
+    res.hitRate = (double)hits / calls;
+    return res;
+}
+
+// --------------------------------------------------------------------------
+void print(std::ostream& out, const BenchResult& r, bool last)
+{
+    out << "    { \"name\": " << jsonString(r.name)
+        << ", \"inputs\": " << jsonString(r.inputs)
+        << ", \"calls\": " << r.calls
+        << ", \"ns_per_call\": " << r.nsPerCall
+        << ", \"calls_per_sec\": " << r.callsPerSec
+        << ", \"allocs_per_call\": " << r.allocsPerCall
+        << ", \"hit_rate\": " << r.hitRate
+        << " }" << (last ? "" : ",") << std::endl;
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> args;
+    if(argc>1) args = std::vector<std::string>(argv+1,argv+argc);
+
+    unsigned long long calls = args.size() > 0 ? std::stoull(args[0]) : 200000;
+    unsigned seed = args.size() > 1 ? std::stoul(args[1]) : 1;
+
+    Arr<BenchResult> results;
+
+    // segments ---------------------------------------------------------------
+    {
+        Inputs in(seed);
+        Arr<Vec2> a(INPUT_COUNT), b(INPUT_COUNT), c(INPUT_COUNT), d(INPUT_COUNT);
+        for(unsigned i=0; i<INPUT_COUNT; ++i) { a[i]=in.point(50.f); b[i]=in.point(50.f); c[i]=in.point(50.f); d[i]=in.point(50.f); }
+        results.push_back( run("Seg2Seg", "random", calls, [&](unsigned i)
+        {
+            Vec2 p;
+            return Seg2Seg(a[i], b[i], c[i], d[i], p);
+        }));
+
+        for(unsigned i=0; i<INPUT_COUNT; ++i) in.parallel(a[i], b[i], c[i], d[i]);
+        results.push_back( run("Seg2Seg", "parallel", calls, [&](unsigned i)
+        {
+            Vec2 p;
+            return Seg2Seg(a[i], b[i], c[i], d[i], p);
+        }));
+    }
+
+    // segment vs polygon -----------------------------------------------------
+    {
+        Inputs in(seed);
+        Arr<Vec2> a(INPUT_COUNT), b(INPUT_COUNT);
+        Arr<Polygon> p(INPUT_COUNT);
+        for(unsigned i=0; i<INPUT_COUNT; ++i) { p[i]=in.rect(20.f,true); a[i]=in.point(40.f); b[i]=in.point(40.f); }
+        results.push_back( run("Seg2Poly", "rotated rects", calls, [&](unsigned i)
+        {
+            Vec2 points[4], normals[4];
+            VecBuffer res_p(points,4), res_n(normals,4);
+            return Seg2Poly(a[i], b[i], p[i], res_p, res_n);
+        }));
+
+        for(unsigned i=0; i<INPUT_COUNT; ++i)
+        {
+            p[i]=in.rect(20.f,false);
+            in.parallel(p[i].vertices[0], p[i].vertices[1], a[i], b[i]);
+        }
+        results.push_back( run("Seg2Poly", "parallel edges", calls, [&](unsigned i)
+        {
+            Vec2 points[4], normals[4];
+            VecBuffer res_p(points,4), res_n(normals,4);
+            return Seg2Poly(a[i], b[i], p[i], res_p, res_n);
+        }));
+    }
+
+    // circle vs line and segment ---------------------------------------------
+    {
+        Inputs in(seed);
+        Arr<Circle> c(INPUT_COUNT);
+        Arr<Vec2> a(INPUT_COUNT), b(INPUT_COUNT);
+        for(unsigned i=0; i<INPUT_COUNT; ++i) { c[i]=Circle(in.point(30.f), in.uniform(2.f,15.f)); a[i]=in.point(40.f); b[i]=in.point(40.f); }
+        results.push_back( run("Circle2Line", "random", calls, [&](unsigned i)
+        {
+            Vec2 points[2];
+            VecBuffer res_p(points,2);
+            return Circle2Line(c[i], a[i], b[i], res_p);
+        }));
+        results.push_back( run("Circle2Seg", "random", calls, [&](unsigned i)
+        {
+            Vec2 points[2];
+            VecBuffer res_p(points,2);
+            return Circle2Seg(c[i], a[i], b[i], res_p);
+        }));
+    }
+
+    // circle vs polygon ------------------------------------------------------
+    {
+        Inputs in(seed);
+        Arr<Circle> c(INPUT_COUNT);
+        Arr<Polygon> p(INPUT_COUNT);
+        for(unsigned i=0; i<INPUT_COUNT; ++i) { p[i]=in.rect(20.f,true); c[i]=Circle(in.point(30.f), in.uniform(2.f,15.f)); }
+        results.push_back( run("Circle2Poly", "rotated rects", calls, [&](unsigned i)
+        {
+            Vec2 points[20], normals[4];
+            VecBuffer res_p(points,20), res_n(normals,4);
+            return Circle2Poly(c[i], p[i], res_p, res_n);
+        }));
+    }
+
+    // polygon vs polygon -----------------------------------------------------
+    {
+        Inputs in(seed);
+        Arr<Polygon> p1(INPUT_COUNT), p2(INPUT_COUNT);
+        for(unsigned i=0; i<INPUT_COUNT; ++i) { p1[i]=in.rect(20.f,true); p2[i]=in.rect(20.f,true); }
+        results.push_back( run("Poly2Poly", "rotated rects", calls, [&](unsigned i)
+        {
+            Vec2 points[24], normals1[24], normals2[24];
+            VecBuffer res_p(points,24), res_n1(normals1,24), res_n2(normals2,24);
+            return Poly2Poly(p1[i], p2[i], res_p, res_n1, res_n2);
+        }));
+
+        // stacked boxes : touching parallel edges
+        for(unsigned i=0; i<INPUT_COUNT; ++i)
+        {
+            float w = in.uniform(4.f,30.f), h = in.uniform(4.f,30.f);
+            Vec2 c = in.point(20.f);
+            p1[i] = Polygon(w, h, c);
+            p2[i] = Polygon(in.uniform(4.f,30.f), h, c + Vec2( in.uniform(-w,w)*0.5f, h - in.uniform(0.f,1.f) ));
+        }
+        results.push_back( run("Poly2Poly", "stacked rects", calls, [&](unsigned i)
+        {
+            Vec2 points[24], normals1[24], normals2[24];
+            VecBuffer res_p(points,24), res_n1(normals1,24), res_n2(normals2,24);
+            return Poly2Poly(p1[i], p2[i], res_p, res_n1, res_n2);
+        }));
+    }
+
+    // bounding boxes and separating axis ---------------------------------------
+    {
+        Inputs in(seed);
+        Arr<AABB> b1(INPUT_COUNT), b2(INPUT_COUNT);
+        for(unsigned i=0; i<INPUT_COUNT; ++i)
+        {
+            Vec2 c1 = in.point(30.f), c2 = in.point(30.f);
+            b1[i] = AABB(c1, c1 + Vec2(in.uniform(4.f,30.f), in.uniform(4.f,30.f)));
+            b2[i] = AABB(c2, c2 + Vec2(in.uniform(4.f,30.f), in.uniform(4.f,30.f)));
+        }
+        results.push_back( run("AABB2AABB", "random", calls, [&](unsigned i)
+        {
+            return AABB2AABB(b1[i], b2[i]);
+        }));
+
+        Arr<Polygon> p1(INPUT_COUNT), p2(INPUT_COUNT);
+        Arr<Vec2> axis(INPUT_COUNT);
+        for(unsigned i=0; i<INPUT_COUNT; ++i)
+        {
+            p1[i] = in.rect(20.f,true);
+            p2[i] = in.rect(20.f,true);
+            axis[i] = getNormal(p1[i].vertices[0], p1[i].vertices[1]);
+        }
+        results.push_back( run("separatedOnAxis", "rotated rects", calls, [&](unsigned i)
+        {
+            return separatedOnAxis(p1[i], p2[i], axis[i]);
+        }));
+    }
+
+    // point inside polygon ---------------------------------------------------
+    {
+        Inputs in(seed);
+        Arr<Vec2> v(INPUT_COUNT);
+        Arr<Polygon> p(INPUT_COUNT);
+        for(unsigned i=0; i<INPUT_COUNT; ++i) { p[i]=in.rect(10.f,true); v[i]=in.point(25.f); }
+        results.push_back( run("inside", "rotated rects", calls, [&](unsigned i)
+        {
+            return inside(v[i], p[i]);
+        }));
+    }
+
+    // projection on rectangle edges ------------------------------------------
+    {
+        Inputs in(seed);
+        Arr<RectEntity*> r(INPUT_COUNT);
+        Arr<Vec2> dir(INPUT_COUNT);
+        for(unsigned i=0; i<INPUT_COUNT; ++i)
+        {
+            r[i] = new RectEntity(in.point(50.f), in.uniform(4.f,30.f), in.uniform(4.f,30.f));
+            r[i]->rotation() = in.uniform(0.f,360.f);
+            r[i]->update();
+            dir[i] = in.point(20.f);
+        }
+        results.push_back( run("projectOnEdge", "rotated rects", calls, [&](unsigned i)
+        {
+            Vec2 e = projectOnEdge(*r[i], dir[i]);
+            return len2(e) > 0.f;
+        }));
+        for(auto e : r) delete e;
+    }
+
+    std::cout << "{" << std::endl;
+    std::cout << "  \"benchmark\": \"math_intersection\"," << std::endl;
+    std::cout << "  \"seed\": " << seed << "," << std::endl;
+    std::cout << "  \"calls_per_case\": " << calls << "," << std::endl;
+    std::cout << "  \"results\": [" << std::endl;
+    for(unsigned i=0; i<results.size(); ++i) print(std::cout, results[i], i+1 == results.size());
+    std::cout << "  ]" << std::endl;
+    std::cout << "}" << std::endl;
+
+    return 0;
+}
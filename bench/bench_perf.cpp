@@ -0,0 +1,204 @@
+#include "bench_perf.hpp"
+#include "bench_common.hpp"
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <sys/ioctl.h>
+    #include <unistd.h>
+#endif
+
+// --------------------------------------------------------------------------
+const char* perfEventName(PerfEvent e)
+{
+    switch(e)
+    {
+        case PERF_CYCLES : return "cycles";
+        case PERF_INSTRUCTIONS : return "instructions";
+        case PERF_L1D_ACCESSES : return "l1d_accesses";
+        case PERF_L1D_MISSES : return "l1d_misses";
+        case PERF_LLC_REFERENCES : return "llc_references";
+        case PERF_LLC_MISSES : return "llc_misses";
+        case PERF_BRANCHES : return "branches";
+        case PERF_BRANCH_MISSES : return "branch_misses";
+        default : return "unknown";
+    }
+}
+
+#if defined(__linux__)
+
+// --------------------------------------------------------------------------
+int openEvent(PerfEvent e)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    const unsigned long long l1dRead = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8);
+    switch(e)
+    {
+        case PERF_CYCLES : attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case PERF_INSTRUCTIONS : attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case PERF_LLC_REFERENCES : attr.config = PERF_COUNT_HW_CACHE_REFERENCES; break;
+        case PERF_LLC_MISSES : attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+        case PERF_BRANCHES : attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS; break;
+        case PERF_BRANCH_MISSES : attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        case PERF_L1D_ACCESSES :
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = l1dRead | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16);
+            break;
+        case PERF_L1D_MISSES :
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = l1dRead | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        default : return -1;
+    }
+
+    // this thread, any cpu
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#endif
+
+// --------------------------------------------------------------------------
+PerfCounters::PerfCounters()
+{
+    for(unsigned e=0; e<PERF_EVENT_COUNT; ++e)
+    {
+#if defined(__linux__)
+        fds[e] = openEvent((PerfEvent)e);
+        if(fds[e] < 0 && error.empty())
+            error = std::string(perfEventName((PerfEvent)e)) + " : " + std::strerror(errno);
+#else
+        fds[e] = -1;
+        if(error.empty()) error = "perf_event_open is only available on linux";
+#endif
+    }
+    reset();
+}
+
+// --------------------------------------------------------------------------
+PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+    for(auto fd : fds) if(fd >= 0) close(fd);
+#endif
+}
+
+// --------------------------------------------------------------------------
+bool PerfCounters::available() const
+{
+    for(unsigned e=0; e<PERF_EVENT_COUNT; ++e)
+        if( available((PerfEvent)e) ) return true;
+    return false;
+}
+
+// --------------------------------------------------------------------------
+bool PerfCounters::available(PerfEvent e) const
+{
+    return fds[e] >= 0;
+}
+
+// --------------------------------------------------------------------------
+void PerfCounters::reset()
+{
+    std::memset(value, 0, sizeof(value));
+    std::memset(enabled, 0, sizeof(enabled));
+    std::memset(running, 0, sizeof(running));
+}
+
+// --------------------------------------------------------------------------
+void PerfCounters::read(unsigned long long* v, unsigned long long* en, unsigned long long* run) const
+{
+    for(unsigned e=0; e<PERF_EVENT_COUNT; ++e)
+    {
+        unsigned long long data[3] = {0,0,0};
+#if defined(__linux__)
+        if(fds[e] >= 0 && ::read(fds[e], data, sizeof(data)) != (ssize_t)sizeof(data)) data[0] = data[1] = data[2] = 0;
+#endif
+        v[e] = data[0];
+        en[e] = data[1];
+        run[e] = data[2];
+    }
+}
+
+// --------------------------------------------------------------------------
+void PerfCounters::beginPhase(PhysicPhase)
+{
+    read(startValue, startEnabled, startRunning);
+}
+
+// --------------------------------------------------------------------------
+void PerfCounters::endPhase(PhysicPhase phase)
+{
+    unsigned long long v[PERF_EVENT_COUNT], en[PERF_EVENT_COUNT], run[PERF_EVENT_COUNT];
+    read(v, en, run);
+    for(unsigned e=0; e<PERF_EVENT_COUNT; ++e)
+    {
+        value[phase][e] += v[e] - startValue[e];
+        enabled[phase][e] += en[e] - startEnabled[e];
+        running[phase][e] += run[e] - startRunning[e];
+    }
+}
+
+// --------------------------------------------------------------------------
+double PerfCounters::count(PhysicPhase phase, PerfEvent e) const
+{
+    if( !available(e) ) return -1.0;
+    if(running[phase][e] == 0) return value[phase][e] == 0 && enabled[phase][e] == 0 ? 0.0 : -1.0;
+
+    // the event was only counted part of the time when counters are multiplexed
+    return (double)value[phase][e] * enabled[phase][e] / running[phase][e];
+}
+
+// --------------------------------------------------------------------------
+double PerfCounters::ratio(PhysicPhase phase, PerfEvent a, PerfEvent b) const
+{
+    double ca = count(phase, a), cb = count(phase, b);
+    if(ca < 0.0 || cb <= 0.0) return -1.0;
+    return ca / cb;
+}
+
+// --------------------------------------------------------------------------
+// json number, null for unavailable values
+std::string jsonNumber(double v)
+{
+    if(v < 0.0) return "null";
+    std::ostringstream out;
+    out << v;
+    return out.str();
+}
+
+// --------------------------------------------------------------------------
+std::string PerfCounters::json() const
+{
+    std::ostringstream out;
+    if( !available() )
+    {
+        out << "{ \"available\": false, \"error\": " << jsonString(error) << " }";
+        return out.str();
+    }
+
+    out << "{ \"available\": true";
+    for(unsigned p=0; p<PHASE_COUNT; ++p)
+    {
+        PhysicPhase phase = (PhysicPhase)p;
+        out << ", \"" << phaseName(phase) << "\": {";
+        for(unsigned e=0; e<PERF_EVENT_COUNT; ++e)
+            out << " \"" << perfEventName((PerfEvent)e) << "\": " << jsonNumber( count(phase,(PerfEvent)e) ) << ",";
+        out << " \"ipc\": " << jsonNumber( ratio(phase, PERF_INSTRUCTIONS, PERF_CYCLES) )
+            << ", \"l1d_miss_rate\": " << jsonNumber( ratio(phase, PERF_L1D_MISSES, PERF_L1D_ACCESSES) )
+            << ", \"llc_miss_rate\": " << jsonNumber( ratio(phase, PERF_LLC_MISSES, PERF_LLC_REFERENCES) )
+            << ", \"branch_miss_rate\": " << jsonNumber( ratio(phase, PERF_BRANCH_MISSES, PERF_BRANCHES) )
+            << " }";
+    }
+    out << " }";
+    return out.str();
+}
@@ -0,0 +1,75 @@
+#ifndef BENCH_PERF_HPP
+#define BENCH_PERF_HPP
+
+#include <string>
+#include "physics/physic_profiler.hpp"
+
+// --------------------------------------------------------------------------
+// hardware events sampled around each phase
+enum PerfEvent
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_ACCESSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_REFERENCES,
+    PERF_LLC_MISSES,
+    PERF_BRANCHES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+};
+
+// --------------------------------------------------------------------------
+// per phase hardware counters (linux perf_event_open, user space of the calling thread only :
+// work run by the pool workers is not counted, profile an engine using a single thread pool)
+// events which cannot be opened (no pmu in a vm or container, perf_event_paranoid...) are
+// reported as unavailable, the engine runs the same without them
+struct PerfCounters : public PhysicProfiler
+{
+    // file descriptor of each event (-1 if unavailable)
+    int fds[PERF_EVENT_COUNT];
+
+    // why the first unavailable event could not be opened
+    std::string error;
+
+    // accumulated raw deltas per phase : value, time enabled, time running
+    unsigned long long value[PHASE_COUNT][PERF_EVENT_COUNT];
+    unsigned long long enabled[PHASE_COUNT][PERF_EVENT_COUNT];
+    unsigned long long running[PHASE_COUNT][PERF_EVENT_COUNT];
+
+    PerfCounters();
+    virtual ~PerfCounters();
+
+    // test if at least one event is counted
+    bool available() const;
+    bool available(PerfEvent e) const;
+
+    // reset the accumulated counts
+    void reset();
+
+    // counted events of a phase, scaled for multiplexing (-1 if unavailable)
+    double count(PhysicPhase phase, PerfEvent e) const;
+
+    // a / b of two counts (-1 if one is unavailable or b is null)
+    double ratio(PhysicPhase phase, PerfEvent a, PerfEvent b) const;
+
+    virtual void beginPhase(PhysicPhase phase);
+    virtual void endPhase(PhysicPhase phase);
+
+    // json object of the counts and rates (ipc, miss rates) per phase
+    std::string json() const;
+
+protected:
+    // values read at the beginning of the current phase
+    unsigned long long startValue[PERF_EVENT_COUNT];
+    unsigned long long startEnabled[PERF_EVENT_COUNT];
+    unsigned long long startRunning[PERF_EVENT_COUNT];
+
+    void read(unsigned long long* v, unsigned long long* en, unsigned long long* run) const;
+};
+
+// --------------------------------------------------------------------------
+// printable name of an event
+const char* perfEventName(PerfEvent e);
+
+#endif // BENCH_PERF_HPP
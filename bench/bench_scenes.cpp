@@ -0,0 +1,391 @@
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "bench_common.hpp"
+#include "bench_perf.hpp"
+#include "physics/physic_engine.hpp"
+#include "scene.hpp"
+
+// scene benchmarks : each world is stepped a fixed number of frames at several body counts
+// usage : PhysicBenchScenes [steps] [scene name|all] [perf] [--broadphase sap|lbvh|grid|tree] [--threads n,...]
+// perf : add the hardware counters of each phase (linux only, reported as unavailable otherwise)
+//        the counters only see the calling thread, so the engine then runs on a single thread
+// --broadphase : pair finder of the engines (sweep and prune by default)
+// --threads : threads of the engines, 0 for one per hardware core (default)
+//             a list (1,2,4,8) runs every scene at each count, to compare the narrowphase scaling
+// exits with 1 if a step of the steady state (last quarter of the run) allocated memory,
+// if the circle batching made the narrowphase of a world slower than the scalar one,
+// or if a world did not stay bounded (a body left it, or its kinetic energy kept growing), with 2 on a bad argument
+
+#define STEP_DT (1.f/60.f)
+
+// distance a body may go past the bounds of the scene at its start (pixels)
+#define SCENE_MARGIN 200.f
+
+// kinetic energy of the last quarter of a run against the highest one of the quarters before,
+// above it the world is not settling (a stack toppling moves it less, a solver blowing up much more)
+#define ENERGY_GROWTH_MAX 3.0
+
+// --------------------------------------------------------------------------
+// a world and its body counts
+struct SceneCase
+{
+    const char* name;
+    void (*build)(PhysicEngine& engine, unsigned size);
+    
+    // body counts, 0 for none
+    unsigned sizes[4];
+};
+
+void tiledDemo(PhysicEngine& engine, unsigned size) { buildTiledDemoScene(engine, (unsigned)std::ceil(std::sqrt(size/24.f))); }
+void circleRain(PhysicEngine& engine, unsigned size) { buildCircleRain(engine, size); }
+void pyramids(PhysicEngine& engine, unsigned size) { buildPyramids(engine, size); }
+void sparseWorld(PhysicEngine& engine, unsigned size) { buildSparseWorld(engine, size); }
+
+static const SceneCase scenes[] =
+{
+    { "tiled_demo", tiledDemo, { 100, 400, 1600, 0 } },
+    { "circle_rain", circleRain, { 1000, 4000, 10000, 100000 } },
+    { "pyramids", pyramids, { 210, 840, 3360, 0 } },
+    { "sparse", sparseWorld, { 400, 1600, 6400, 100000 } },
+};
+
+struct SceneResult
+{
+    std::string name;
+    std::string broadphase;
+    unsigned bodies;
+    unsigned threads;
+    unsigned steps;
+    double p50, p95, p99, mean;
+    double broadphaseMean;
+    double narrowphaseMean;
+    double bodiesPerSec;
+    double contactsPerStep;
+    double pairsPerStep;
+    double batchedCircles;
+    double circleBatchFill;
+    double scalarNarrowphaseMean;
+    double batchingNarrowphaseMean;
+    bool batchingOk;
+    double allocsPerStep;
+    double steadyAllocsPerStep;
+    bool steadyAllocsOk;
+    unsigned sleepingBodies;
+    unsigned bodiesOut;
+    double energyGrowth;
+    bool boundedOk;
+    std::string perf;
+};
+
+// --------------------------------------------------------------------------
+// nearest rank percentile of sorted values
+double percentile(const Arr<double>& sorted, double q)
+{
+    if(sorted.empty()) return 0.0;
+    unsigned rank = (unsigned)std::ceil(q * sorted.size());
+    return sorted[ std::min<unsigned>(rank > 0 ? rank-1 : 0, sorted.size()-1) ];
+}
+
+// --------------------------------------------------------------------------
+// bounds of the static geometry and of the bodies
+AABB sceneBounds(const PhysicEngine& engine)
+{
+    AABB bounds;
+    bool empty = true;
+    for(auto& b : engine.staticGeometry.boxes)
+    {
+        if(empty) bounds = b;
+        else bounds.extend(b);
+        empty = false;
+    }
+    for(auto& p : engine.bodies.position)
+    {
+        if(empty) bounds = AABB(p, p);
+        else bounds.extend(p);
+        empty = false;
+    }
+    return bounds;
+}
+
+// --------------------------------------------------------------------------
+// linear kinetic energy of the bodies (velocities in pixels per step)
+double kineticEnergy(const PhysicEngine& engine)
+{
+    double energy = 0.0;
+    for(unsigned s=0; s<engine.bodies.size(); ++s)
+        energy += 0.5 * engine.bodies.mass[s] * len2(engine.bodies.v_linear[s]);
+    return energy;
+}
+
+// --------------------------------------------------------------------------
+SceneResult run(const SceneCase& scene, unsigned size, unsigned steps, bool perf, const std::string& broadphase, unsigned threads)
+{
+    // phases run on the pool workers would escape the counters
+    ThreadPool pool(perf ? 1 : threads);
+    PhysicEngine engine(makeBroadphase(broadphase, &pool), &pool);
+    engine.allowSleep = true;
+    scene.build(engine, size);
+    
+    PerfCounters* counters = perf ? new PerfCounters() : nullptr;
+    engine.profiler = counters;
+    
+    AABB bounds = sceneBounds(engine);
+    bounds.min -= Vec2(SCENE_MARGIN, SCENE_MARGIN);
+    bounds.max += Vec2(SCENE_MARGIN, SCENE_MARGIN);
+
+    Arr<double> times;
+    times.reserve(steps);
+    double contacts = 0.0, pairs = 0.0, broadphaseTime = 0.0, narrowphaseTime = 0.0;
+    double circlePairs = 0.0, batchedCircles = 0.0, circleBatches = 0.0;
+    unsigned long long allocs = allocationCount();
+    
+    // the last quarter of the run is the steady state : buffers have reached their size
+    unsigned steadyStart = steps - steps/4;
+    unsigned long long steadyAllocs = 0;
+    
+    // mean kinetic energy of each quarter of the run
+    double energy[4] = {};
+
+    for(unsigned i=0; i<steps; ++i)
+    {
+        if(i == steadyStart) steadyAllocs = allocationCount();
+        
+        double start = nowNs();
+        engine.updateEntities(STEP_DT);
+        times.push_back( (nowNs() - start) * 1e-6 );
+
+        broadphaseTime += engine.stats.broadphaseTime;
+        narrowphaseTime += engine.stats.narrowphaseTime;
+        contacts += engine.collisions.size();
+        pairs += engine.pairs.size();
+        circlePairs += engine.stats.circlePairs;
+        batchedCircles += engine.stats.batchedCirclePairs;
+        circleBatches += engine.stats.circleBatches;
+        
+        energy[ std::min(i * 4 / steps, 3u) ] += kineticEnergy(engine) / std::max(steps/4, 1u);
+    }
+    allocs = allocationCount() - allocs;
+    steadyAllocs = allocationCount() - steadyAllocs;
+
+    SceneResult res;
+    res.name = scene.name;
+    res.broadphase = broadphase;
+    res.bodies = engine.bodies.size();
+    res.threads = engine.pool->size();
+    res.steps = steps;
+
+    double total = 0.0;
+    for(auto t : times) total += t;
+    std::sort(times.begin(), times.end());
+    res.p50 = percentile(times, 0.50);
+    res.p95 = percentile(times, 0.95);
+    res.p99 = percentile(times, 0.99);
+    res.mean = steps ? total / steps : 0.0;
+    res.broadphaseMean = steps ? broadphaseTime / steps : 0.0;
+    res.narrowphaseMean = steps ? narrowphaseTime / steps : 0.0;
+    res.bodiesPerSec = total > 0.0 ? (double)res.bodies * steps / (total * 1e-3) : 0.0;
+    res.contactsPerStep = steps ? contacts / steps : 0.0;
+    res.pairsPerStep = steps ? pairs / steps : 0.0;
+    res.batchedCircles = circlePairs > 0.0 ? batchedCircles / circlePairs : 0.0;
+    res.circleBatchFill = circleBatches > 0.0 ? batchedCircles / circleBatches : 0.0;
+    res.allocsPerStep = steps ? (double)allocs / steps : 0.0;
+    res.steadyAllocsPerStep = steps/4 ? (double)steadyAllocs / (steps/4) : 0.0;
+    res.steadyAllocsOk = steadyAllocs == 0;
+    res.scalarNarrowphaseMean = 0.0;
+    res.batchingNarrowphaseMean = 0.0;
+    res.batchingOk = true;
+    res.sleepingBodies = engine.stats.sleepingBodies;
+    
+    // a body out of the scene falls forever, a growing energy is a solver blowing up
+    res.bodiesOut = 0;
+    for(auto& p : engine.bodies.position)
+        if(p.x < bounds.min.x || p.y < bounds.min.y || p.x > bounds.max.x || p.y > bounds.max.y) res.bodiesOut++;
+    double before = std::max(energy[0], std::max(energy[1], energy[2]));
+    res.energyGrowth = before > 0.0 ? energy[3] / before : 0.0;
+    res.boundedOk = res.bodiesOut == 0 && res.energyGrowth <= ENERGY_GROWTH_MAX;
+    if(counters) res.perf = counters->json();
+    delete counters;
+
+    destroyScene(engine);
+    return res;
+}
+
+// --------------------------------------------------------------------------
+// narrowphase of a world with the circle batching of the best instruction set against the
+// scalar one (the pair tests only), the 2 worlds stepped in turn so both see the same machine load
+// not run for a world without circles or a cpu without vector test (both times are then 0)
+void compareBatching(const SceneCase& scene, unsigned size, unsigned steps, const std::string& broadphase, unsigned threads, SceneResult& res)
+{
+    res.scalarNarrowphaseMean = 0.0;
+    res.batchingNarrowphaseMean = 0.0;
+    res.batchingOk = true;
+    
+    ThreadPool pool(threads);
+    PhysicEngine batching(makeBroadphase(broadphase, &pool), &pool);
+    PhysicEngine scalar(makeBroadphase(broadphase, &pool), &pool);
+    batching.allowSleep = true;
+    scalar.allowSleep = true;
+    scalar.simdLevel = SIMD_SCALAR;
+    scene.build(batching, size);
+    scene.build(scalar, size);
+    
+    bool circles = false;
+    for(auto e : batching.bodies.owner) circles = circles || e->shape == SHAPE_CIRCLE;
+    if(circles && circleBatchWidth(batching.simdLevel) > 0)
+    {
+        Arr<double> batchingTimes, scalarTimes;
+        batchingTimes.reserve(steps);
+        scalarTimes.reserve(steps);
+        double batchingTime = 0.0, scalarTime = 0.0;
+        for(unsigned i=0; i<steps; ++i)
+        {
+            batching.updateEntities(STEP_DT);
+            scalar.updateEntities(STEP_DT);
+            batchingTime += batching.stats.narrowphaseTime;
+            scalarTime += scalar.stats.narrowphaseTime;
+            batchingTimes.push_back(batching.stats.narrowphaseTime / std::max(batching.stats.candidatePairs, 1u));
+            scalarTimes.push_back(scalar.stats.narrowphaseTime / std::max(scalar.stats.candidatePairs, 1u));
+        }
+        res.scalarNarrowphaseMean = steps ? scalarTime / steps : 0.0;
+        res.batchingNarrowphaseMean = steps ? batchingTime / steps : 0.0;
+        
+        // the scalar engine also integrates without simd, the two worlds drift apart :
+        // compare the median time per candidate pair, a step slowed down by the machine does not decide
+        std::sort(batchingTimes.begin(), batchingTimes.end());
+        std::sort(scalarTimes.begin(), scalarTimes.end());
+        res.batchingOk = percentile(batchingTimes, 0.5) <= percentile(scalarTimes, 0.5) * 1.1;
+    }
+    
+    destroyScene(batching);
+    destroyScene(scalar);
+}
+
+// --------------------------------------------------------------------------
+void print(std::ostream& out, const SceneResult& r, bool last)
+{
+    out << "    { \"scene\": " << jsonString(r.name)
+        << ", \"broadphase\": " << jsonString(r.broadphase)
+        << ", \"bodies\": " << r.bodies
+        << ", \"threads\": " << r.threads
+        << ", \"steps\": " << r.steps
+        << ", \"p50_ms\": " << r.p50
+        << ", \"p95_ms\": " << r.p95
+        << ", \"p99_ms\": " << r.p99
+        << ", \"mean_ms\": " << r.mean
+        << ", \"broadphase_ms\": " << r.broadphaseMean
+        << ", \"narrowphase_ms\": " << r.narrowphaseMean
+        << ", \"bodies_per_sec\": " << r.bodiesPerSec
+        << ", \"contacts_per_step\": " << r.contactsPerStep
+        << ", \"pairs_per_step\": " << r.pairsPerStep
+        << ", \"batched_circle_pairs\": " << r.batchedCircles
+        << ", \"circle_batch_fill\": " << r.circleBatchFill
+        << ", \"scalar_narrowphase_ms\": " << r.scalarNarrowphaseMean
+        << ", \"batching_narrowphase_ms\": " << r.batchingNarrowphaseMean
+        << ", \"batching_ok\": " << (r.batchingOk ? "true" : "false")
+        << ", \"allocs_per_step\": " << r.allocsPerStep
+        << ", \"steady_allocs_per_step\": " << r.steadyAllocsPerStep
+        << ", \"steady_allocs_ok\": " << (r.steadyAllocsOk ? "true" : "false")
+        << ", \"sleeping_bodies\": " << r.sleepingBodies
+        << ", \"bodies_out\": " << r.bodiesOut
+        << ", \"energy_growth\": " << r.energyGrowth
+        << ", \"bounded_ok\": " << (r.boundedOk ? "true" : "false");
+    if( !r.perf.empty() ) out << ", \"perf\": " << r.perf;
+    out << " }" << (last ? "" : ",") << std::endl;
+}
+
+
+
+// --------------------------------------------------------------------------
+// thread counts separated by commas, return false on a value which is not a number
+bool parseThreads(const std::string& list, Arr<unsigned>& out_threads)
+{
+    out_threads.clear();
+    const char* p = list.c_str();
+    while(true)
+    {
+        char* end;
+        unsigned long n = std::strtoul(p, &end, 10);
+        if(end == p || (*end != ',' && *end != '\0')) return false;
+        out_threads.push_back((unsigned)n);
+        if(*end == '\0') return true;
+        p = end + 1;
+    }
+}
+
+// --------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    // options anywhere, the other arguments in order
+    std::vector<std::string> args;
+    std::string broadphase = "sap";
+    Arr<unsigned> threads(1, 0);
+    for(int i=1; i<argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "--broadphase" && i+1 < argc) broadphase = argv[++i];
+        else if(arg == "--threads" && i+1 < argc)
+        {
+            if( !parseThreads(argv[++i], threads) )
+            {
+                std::cerr << "bad thread counts " << argv[i] << " (n or n,n,...)" << std::endl;
+                return 2;
+            }
+        }
+        else args.push_back(arg);
+    }
+    
+    ThreadPool probe(1);
+    Broadphase* known = makeBroadphase(broadphase, &probe);
+    if(known == nullptr)
+    {
+        std::cerr << "unknown broadphase " << broadphase << " (sap, lbvh, grid or tree)" << std::endl;
+        return 2;
+    }
+    delete known;
+
+    unsigned steps = args.size() > 0 ? std::stoul(args[0]) : 200;
+    std::string only = args.size() > 1 && args[1] != "all" ? args[1] : "";
+    bool perf = args.size() > 2 && args[2] == "perf";
+
+    Arr<SceneResult> results;
+    for(auto& scene : scenes)
+    {
+        if(!only.empty() && only != scene.name) continue;
+        for(auto size : scene.sizes)
+            for(auto n : threads)
+            {
+                if(size == 0) continue;
+                results.push_back( run(scene, size, steps, perf, broadphase, n) );
+                
+                // the hardware counters would only slow down one of the 2 worlds
+                if(!perf) compareBatching(scene, size, steps, broadphase, n, results.back());
+            }
+    }
+
+    std::cout << "{" << std::endl;
+    std::cout << "  \"benchmark\": \"scenes\"," << std::endl;
+    std::cout << "  \"steps\": " << steps << "," << std::endl;
+    std::cout << "  \"dt\": " << STEP_DT << "," << std::endl;
+    std::cout << "  \"broadphase\": " << jsonString(broadphase) << "," << std::endl;
+    std::cout << "  \"results\": [" << std::endl;
+    for(unsigned i=0; i<results.size(); ++i) print(std::cout, results[i], i+1 == results.size());
+    std::cout << "  ]," << std::endl;
+    
+    // the engine keeps its buffers from one step to the next : a settled world must not allocate
+    bool steadyOk = true;
+    for(auto& r : results) steadyOk = steadyOk && r.steadyAllocsOk;
+    bool batchedOk = true;
+    for(auto& r : results) batchedOk = batchedOk && r.batchingOk;
+    std::cout << "  \"steady_allocs_ok\": " << (steadyOk ? "true" : "false") << "," << std::endl;
+    bool boundedOk = true;
+    for(auto& r : results) boundedOk = boundedOk && r.boundedOk;
+    std::cout << "  \"batching_ok\": " << (batchedOk ? "true" : "false") << "," << std::endl;
+    std::cout << "  \"bounded_ok\": " << (boundedOk ? "true" : "false") << std::endl;
+    std::cout << "}" << std::endl;
+
+    return steadyOk && batchedOk && boundedOk ? 0 : 1;
+}
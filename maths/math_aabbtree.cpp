@@ -0,0 +1,308 @@
+#include "math_aabbtree.hpp"
+#include "math_intersection.hpp"
+#include <algorithm>
+
+// --------------------------------------------------------------------------
+bool AABBTree::Node::isLeaf() const { return child1 == NONE; }
+
+// --------------------------------------------------------------------------
+AABBTree::AABBTree(float m)
+    : root(NONE)
+    , freeList(NONE)
+    , margin(m)
+{}
+
+// --------------------------------------------------------------------------
+AABBTree::~AABBTree() {}
+
+// --------------------------------------------------------------------------
+void AABBTree::clear()
+{
+    nodes.clear();
+    root = NONE;
+    freeList = NONE;
+}
+
+// --------------------------------------------------------------------------
+int AABBTree::allocateNode()
+{
+    int id = freeList;
+    if(id != NONE)
+    {
+        freeList = nodes[id].parent;
+    }
+    else
+    {
+        id = nodes.size();
+        nodes.push_back( Node() );
+    }
+    
+    Node& n = nodes[id];
+    n.parent = NONE;
+    n.child1 = NONE;
+    n.child2 = NONE;
+    n.height = 0;
+    n.data = 0;
+    return id;
+}
+
+// --------------------------------------------------------------------------
+void AABBTree::freeNode(int id)
+{
+    nodes[id].parent = freeList;
+    nodes[id].height = -1;
+    freeList = id;
+}
+
+// --------------------------------------------------------------------------
+int AABBTree::insert(const AABB& box, unsigned data)
+{
+    int leaf = allocateNode();
+    Vec2 m(margin,margin);
+    nodes[leaf].box = AABB(box.min-m, box.max+m);
+    nodes[leaf].data = data;
+    insertLeaf(leaf);
+    return leaf;
+}
+
+// --------------------------------------------------------------------------
+void AABBTree::remove(int leaf)
+{
+    removeLeaf(leaf);
+    freeNode(leaf);
+}
+
+// --------------------------------------------------------------------------
+bool AABBTree::move(int leaf, const AABB& box)
+{
+    if( nodes[leaf].box.contains(box) ) return false;
+    
+    removeLeaf(leaf);
+    Vec2 m(margin,margin);
+    nodes[leaf].box = AABB(box.min-m, box.max+m);
+    insertLeaf(leaf);
+    return true;
+}
+
+// --------------------------------------------------------------------------
+void AABBTree::insertLeaf(int leaf)
+{
+    if(root == NONE)
+    {
+        root = leaf;
+        nodes[root].parent = NONE;
+        return;
+    }
+    
+    // find the cheapest sibling (perimeter heuristic)
+    AABB leafBox = nodes[leaf].box;
+    int id = root;
+    while( !nodes[id].isLeaf() )
+    {
+        const Node& n = nodes[id];
+        
+        AABB combined = n.box; combined.extend(leafBox);
+        float cost = 2.f * combined.perimeter();
+        float inheritance = 2.f * (combined.perimeter() - n.box.perimeter());
+        
+        float childCost[2];
+        int children[2] = { n.child1, n.child2 };
+        for(int k=0; k<2; ++k)
+        {
+            const Node& c = nodes[children[k]];
+            AABB grown = c.box; grown.extend(leafBox);
+            childCost[k] = grown.perimeter() + inheritance;
+            if( !c.isLeaf() ) childCost[k] -= c.box.perimeter();
+        }
+        
+        if(cost < childCost[0] && cost < childCost[1]) break;
+        id = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+    int sibling = id;
+    
+    // new parent replaces the sibling
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    Node& p = nodes[newParent];
+    p.parent = oldParent;
+    p.box = nodes[sibling].box; p.box.extend(leafBox);
+    p.height = nodes[sibling].height + 1;
+    p.child1 = sibling;
+    p.child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+    
+    if(oldParent != NONE)
+    {
+        if(nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+        else nodes[oldParent].child2 = newParent;
+    }
+    else
+    {
+        root = newParent;
+    }
+    
+    refit( nodes[leaf].parent );
+}
+
+// --------------------------------------------------------------------------
+void AABBTree::removeLeaf(int leaf)
+{
+    if(leaf == root)
+    {
+        root = NONE;
+        return;
+    }
+    
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+    
+    if(grandParent != NONE)
+    {
+        if(nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+        else nodes[grandParent].child2 = sibling;
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refit(grandParent);
+    }
+    else
+    {
+        root = sibling;
+        nodes[sibling].parent = NONE;
+        freeNode(parent);
+    }
+}
+
+// --------------------------------------------------------------------------
+void AABBTree::refit(int id)
+{
+    while(id != NONE)
+    {
+        id = balance(id);
+        
+        Node& n = nodes[id];
+        const Node& c1 = nodes[n.child1];
+        const Node& c2 = nodes[n.child2];
+        n.height = 1 + std::max(c1.height, c2.height);
+        n.box = c1.box; n.box.extend(c2.box);
+        
+        id = n.parent;
+    }
+}
+
+// --------------------------------------------------------------------------
+int AABBTree::balance(int iA)
+{
+    Node& A = nodes[iA];
+    if(A.isLeaf() || A.height < 2) return iA;
+    
+    int iB = A.child1;
+    int iC = A.child2;
+    int diff = nodes[iC].height - nodes[iB].height;
+    if(diff >= -1 && diff <= 1) return iA;
+    
+    // promote the higher child (up), its sibling stays under A
+    int iUp = diff > 0 ? iC : iB;
+    int iOther = diff > 0 ? iB : iC;
+    Node& up = nodes[iUp];
+    int iF = up.child1;
+    int iG = up.child2;
+    
+    // swap A and up
+    up.child1 = iA;
+    up.parent = A.parent;
+    A.parent = iUp;
+    if(up.parent != NONE)
+    {
+        if(nodes[up.parent].child1 == iA) nodes[up.parent].child1 = iUp;
+        else nodes[up.parent].child2 = iUp;
+    }
+    else
+    {
+        root = iUp;
+    }
+    
+    // the higher grandchild stays under up, the other replaces up under A
+    int iKeep = nodes[iF].height > nodes[iG].height ? iF : iG;
+    int iMove = iKeep == iF ? iG : iF;
+    up.child2 = iKeep;
+    if(A.child1 == iUp) A.child1 = iMove;
+    else A.child2 = iMove;
+    nodes[iMove].parent = iA;
+    
+    A.box = nodes[iOther].box; A.box.extend(nodes[iMove].box);
+    A.height = 1 + std::max(nodes[iOther].height, nodes[iMove].height);
+    up.box = A.box; up.box.extend(nodes[iKeep].box);
+    up.height = 1 + std::max(A.height, nodes[iKeep].height);
+    
+    return iUp;
+}
+
+// --------------------------------------------------------------------------
+void AABBTree::query(const AABB& box, Arr<unsigned>& out_data) const
+{
+    if(root != NONE) query(root, box, out_data);
+}
+
+// --------------------------------------------------------------------------
+void AABBTree::query(int id, const AABB& box, Arr<unsigned>& out_data) const
+{
+    const Node& n = nodes[id];
+    if( !AABB2AABB(n.box, box) ) return;
+    
+    if( n.isLeaf() )
+    {
+        out_data.push_back(n.data);
+        return;
+    }
+    query(n.child1, box, out_data);
+    query(n.child2, box, out_data);
+}
+
+// --------------------------------------------------------------------------
+void AABBTree::findPairs(Arr< std::pair<unsigned,unsigned> >& out_pairs) const
+{
+    if(root != NONE) selfPairs(root, out_pairs);
+}
+
+// --------------------------------------------------------------------------
+void AABBTree::selfPairs(int id, Arr< std::pair<unsigned,unsigned> >& out_pairs) const
+{
+    const Node& n = nodes[id];
+    if( n.isLeaf() ) return;
+    
+    selfPairs(n.child1, out_pairs);
+    selfPairs(n.child2, out_pairs);
+    crossPairs(n.child1, n.child2, out_pairs);
+}
+
+// --------------------------------------------------------------------------
+void AABBTree::crossPairs(int id1, int id2, Arr< std::pair<unsigned,unsigned> >& out_pairs) const
+{
+    const Node& n1 = nodes[id1];
+    const Node& n2 = nodes[id2];
+    if( !AABB2AABB(n1.box, n2.box) ) return;
+    
+    if( n1.isLeaf() && n2.isLeaf() )
+    {
+        out_pairs.push_back( std::make_pair(n1.data, n2.data) );
+    }
+    else if( n2.isLeaf() || (!n1.isLeaf() && n1.height >= n2.height) )
+    {
+        // descend the bigger subtree
+        crossPairs(n1.child1, id2, out_pairs);
+        crossPairs(n1.child2, id2, out_pairs);
+    }
+    else
+    {
+        crossPairs(id1, n2.child1, out_pairs);
+        crossPairs(id1, n2.child2, out_pairs);
+    }
+}
+
+// --------------------------------------------------------------------------
+int AABBTree::height() const
+{
+    return root == NONE ? 0 : nodes[root].height;
+}
@@ -0,0 +1,84 @@
+#ifndef MATH_AABBTREE_HPP
+#define MATH_AABBTREE_HPP
+
+#include "math_geometry.hpp"
+#include <utility>
+
+
+// --------------------------------------------------------------------------
+// dynamic bounding volume tree
+// each leaf stores a fattened box, so a leaf is only reinserted when its object leaves it
+struct AABBTree
+{
+    static const int NONE = -1;
+
+    struct Node
+    {
+        AABB box;
+        int parent;
+        int child1;
+        int child2;
+
+        // leaf = 0, free node = -1
+        int height;
+
+        // user value of a leaf
+        unsigned data;
+
+        bool isLeaf() const;
+    };
+
+    // node pool (free nodes are chained by 'parent')
+    Arr<Node> nodes;
+    int root;
+    int freeList;
+
+    // fattening distance added around each leaf box
+    float margin;
+
+    // m : fattening margin
+    AABBTree(float m = 4.f);
+    virtual ~AABBTree();
+
+    // remove all leaves
+    void clear();
+
+    // add a leaf and return its id
+    int insert(const AABB& box, unsigned data);
+
+    // remove a leaf
+    void remove(int leaf);
+
+    // update the box of a leaf
+    // return true if the leaf had to be reinserted (box out of its fat box)
+    bool move(int leaf, const AABB& box);
+
+    // append the data of each leaf whose fat box overlaps box
+    void query(const AABB& box, Arr<unsigned>& out_data) const;
+
+    // append each pair of leaves with overlapping fat boxes (only once per pair)
+    void findPairs(Arr< std::pair<unsigned,unsigned> >& out_pairs) const;
+
+    // height of the tree (0 for a single leaf)
+    int height() const;
+
+protected:
+    int allocateNode();
+    void freeNode(int id);
+
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+
+    // walk up from a node, balancing and refitting ancestors
+    void refit(int id);
+
+    // rotate the subtree if unbalanced, return the new subtree root
+    int balance(int id);
+
+    void query(int id, const AABB& box, Arr<unsigned>& out_data) const;
+    void selfPairs(int id, Arr< std::pair<unsigned,unsigned> >& out_pairs) const;
+    void crossPairs(int id1, int id2, Arr< std::pair<unsigned,unsigned> >& out_pairs) const;
+};
+
+
+#endif // MATH_AABBTREE_HPP
@@ -1,4 +1,5 @@
 #include "math_geometry.hpp"
+#include <algorithm>
 
 // --------------------------------------------------------------------------
 Shape::Shape() {}
@@ -8,6 +9,42 @@ Shape::~Shape() {}
 
 
 
+// --------------------------------------------------------------------------
+AABB::AABB() {}
+
+// --------------------------------------------------------------------------
+AABB::AABB(const Vec2& mn, const Vec2& mx) : min(mn), max(mx) {}
+
+// --------------------------------------------------------------------------
+void AABB::extend(const Vec2& v)
+{
+    min.x = std::min(min.x, v.x);
+    min.y = std::min(min.y, v.y);
+    max.x = std::max(max.x, v.x);
+    max.y = std::max(max.y, v.y);
+}
+
+// --------------------------------------------------------------------------
+void AABB::extend(const AABB& b)
+{
+    extend(b.min);
+    extend(b.max);
+}
+
+// --------------------------------------------------------------------------
+bool AABB::contains(const AABB& b) const
+{
+    return min.x <= b.min.x && min.y <= b.min.y && b.max.x <= max.x && b.max.y <= max.y;
+}
+
+// --------------------------------------------------------------------------
+float AABB::perimeter() const
+{
+    return 2.f * ( (max.x-min.x) + (max.y-min.y) );
+}
+
+
+
 // --------------------------------------------------------------------------
 Circle::Circle() {}
 
@@ -20,6 +57,13 @@ Circle::~Circle() {}
 // --------------------------------------------------------------------------
 void Circle::move(const Vec2& va) { center+=va; }
 
+// --------------------------------------------------------------------------
+AABB Circle::bounds() const
+{
+    Vec2 r(radius,radius);
+    return AABB(center-r, center+r);
+}
+
 
 
 // --------------------------------------------------------------------------
@@ -59,6 +103,16 @@ void Polygon::move(const Vec2& va) { for(auto& v : vertices) v+=va; }
 // --------------------------------------------------------------------------
 void Polygon::rotate(float r)
 {
-    sf::Transform rot; rot.rotate(r);
+    Transform rot; rot.rotate(r);
     for(auto& v : vertices) v=rot*v;
 }
+
+// --------------------------------------------------------------------------
+AABB Polygon::bounds() const
+{
+    if( vertices.empty() ) return AABB();
+    
+    AABB res(vertices[0],vertices[0]);
+    for(auto& v : vertices) res.extend(v);
+    return res;
+}
@@ -10,6 +10,29 @@ struct Shape
     virtual ~Shape();
 };
 
+// --------------------------------------------------------------------------
+// axis aligned bounding box
+struct AABB
+{
+    Vec2 min;
+    Vec2 max;
+    
+    AABB();
+    AABB(const Vec2& mn, const Vec2& mx);
+    
+    // grow the box to include v
+    void extend(const Vec2& v);
+    
+    // grow the box to include b
+    void extend(const AABB& b);
+    
+    // test if b is entirely inside this box
+    bool contains(const AABB& b) const;
+    
+    // perimeter (used as insertion cost by trees)
+    float perimeter() const;
+};
+
 // --------------------------------------------------------------------------
 struct Circle : public Shape
 {
@@ -21,6 +44,8 @@ struct Circle : public Shape
     virtual ~Circle();
     
     void move(const Vec2& va);
+    
+    AABB bounds() const;
 };
 
 // --------------------------------------------------------------------------
@@ -39,6 +64,8 @@ struct Polygon : public Shape
     void insert(const Vec2& v);
     void move(const Vec2& v);
     void rotate(float r);
+    
+    AABB bounds() const;
 };
 
 #endif // MATH_GEOMETRY_HPP
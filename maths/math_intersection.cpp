@@ -1,9 +1,24 @@
 #include "math_intersection.hpp"
 #include <cmath>
+#include <algorithm>
 #include <iostream>
 
 // --------------------------------------------------------------------------
-bool Circle2Circle(const Circle& c1, const Circle& c2, Arr<Vec2>& out_p)
+unsigned poly2PolyCapacity(unsigned n1, unsigned n2)
+{
+    // edge crossings, then inside points of each polygon
+    return n1*n2 + n1 + n2;
+}
+
+// --------------------------------------------------------------------------
+unsigned circle2PolyCapacity(unsigned n)
+{
+    // 2 points per edge, the k-th edge hit repeats the points of the k-1 before
+    return n*(n+1);
+}
+
+// --------------------------------------------------------------------------
+bool Circle2Circle(const Circle& c1, const Circle& c2, VecBuffer& out_p)
 {
     Vec2 dir = c2.center - c1.center;
     float d = len(dir);
@@ -26,7 +41,7 @@ bool Circle2Circle(const Circle& c1, const Circle& c2, Arr<Vec2>& out_p)
 }
 
 // --------------------------------------------------------------------------
-bool getIntersectionPoints(const Polygon& p1, const Polygon& p2, Arr<Vec2>& out_p, Arr<Vec2>& out_n1, Arr<Vec2>& out_n2)
+bool getIntersectionPoints(const Polygon& p1, const Polygon& p2, VecBuffer& out_p, VecBuffer& out_n1, VecBuffer& out_n2)
 {
     if( p1.vertices.empty() || p2.vertices.empty() ) return false;
     
@@ -46,7 +61,7 @@ bool getIntersectionPoints(const Polygon& p1, const Polygon& p2, Arr<Vec2>& out_
 }
 
 // --------------------------------------------------------------------------
-bool getInsidePoints(const Polygon& p1, const Polygon& p2, Arr<Vec2>& out_p, Arr<Vec2>& out_n)
+bool getInsidePoints(const Polygon& p1, const Polygon& p2, VecBuffer& out_p, VecBuffer& out_n)
 {
     if( p1.vertices.empty() || p2.vertices.empty() ) return false;
     
@@ -71,7 +86,7 @@ bool getInsidePoints(const Polygon& p1, const Polygon& p2, Arr<Vec2>& out_p, Arr
 }
 
 // --------------------------------------------------------------------------
-bool Poly2Poly(const Polygon& p1, const Polygon& p2, Arr<Vec2>& out_p, Arr<Vec2>& out_n1, Arr<Vec2>& out_n2)
+bool Poly2Poly(const Polygon& p1, const Polygon& p2, VecBuffer& out_p, VecBuffer& out_n1, VecBuffer& out_n2)
 {
     bool hit = false;
     
@@ -83,7 +98,7 @@ bool Poly2Poly(const Polygon& p1, const Polygon& p2, Arr<Vec2>& out_p, Arr<Vec2>
 }
 
 // --------------------------------------------------------------------------
-bool Circle2Line(const Circle& c, const Vec2& l1, const Vec2& l2, Arr<Vec2>& out_p)
+bool Circle2Line(const Circle& c, const Vec2& l1, const Vec2& l2, VecBuffer& out_p)
 {
     Vec2 cl1 = l1;//-c.center;
     Vec2 cl2 = l2;//-c.center;
@@ -133,13 +148,17 @@ bool Circle2Line(const Circle& c, const Vec2& l1, const Vec2& l2, Arr<Vec2>& out
         
         return true;
     }*/
+    
+    // tangent : ignored
+    return false;
 }
 
 
 // --------------------------------------------------------------------------
-bool Circle2Seg(const Circle& c, const Vec2& s1, const Vec2& s2, Arr<Vec2>& out_p)
+bool Circle2Seg(const Circle& c, const Vec2& s1, const Vec2& s2, VecBuffer& out_p)
 {
-    Arr<Vec2> local_res;
+    Vec2 local[2];
+    VecBuffer local_res(local, 2);
     
     Vec2 l1 = s1-c.center;
     Vec2 l2 = s2-c.center;
@@ -165,18 +184,28 @@ bool Circle2Seg(const Circle& c, const Vec2& s1, const Vec2& s2, Arr<Vec2>& out_
 }
 
 // --------------------------------------------------------------------------
-bool Circle2Poly(const Circle& c, const Polygon& p, Arr<Vec2>& out_p, Arr<Vec2>& out_n)
+bool Circle2Poly(const Circle& c, const Polygon& p, VecBuffer& out_p, VecBuffer& out_n)
 {
     if( p.vertices.empty() ) return false;
     
+    // points of the edges hit so far : the last block appended to out_p
+    unsigned block = out_p.size(), blockSize = 0;
+    
     bool hit = false;
-    Arr<Vec2> local_res;
+    Vec2 local[2];
+    VecBuffer local_res(local, 2);
     Vec2 prev = p.vertices[p.vertices.size()-1];
     for(auto ve : p.vertices)
     {
+        local_res.clear();
         if( Circle2Seg(c,prev,ve,local_res) )
         {
+            unsigned next = out_p.size();
+            for(unsigned i=0; i<blockSize; ++i) out_p.push_back( out_p[block+i] );
             for(auto local_it : local_res) out_p.push_back(local_it);
+            block = next;
+            blockSize += local_res.size();
+            
             out_n.push_back( getNormal(prev,ve) );
             hit = true;
         }
@@ -221,7 +250,7 @@ bool Seg2Seg(const Vec2& s1a, const Vec2& s1b, const Vec2& s2a, const Vec2& s2b,
 }
 
 // --------------------------------------------------------------------------
-bool Seg2Poly(const Vec2& sa, const Vec2& sb, const Polygon& p, Arr<Vec2>& out_p, Arr<Vec2>& out_n)
+bool Seg2Poly(const Vec2& sa, const Vec2& sb, const Polygon& p, VecBuffer& out_p, VecBuffer& out_n)
 {
     if( p.vertices.empty() ) return false;
     
@@ -243,6 +272,46 @@ bool Seg2Poly(const Vec2& sa, const Vec2& sb, const Polygon& p, Arr<Vec2>& out_p
     return hit;
 }
 
+// --------------------------------------------------------------------------
+bool separatedOnAxis(const Polygon& p1, const Polygon& p2, const Vec2& axis)
+{
+    if( p1.vertices.empty() || p2.vertices.empty() ) return false;
+    
+    float min1 = dot(p1.vertices[0],axis), max1 = min1;
+    for(auto& v : p1.vertices) { float d = dot(v,axis); min1 = std::min(min1,d); max1 = std::max(max1,d); }
+    
+    float min2 = dot(p2.vertices[0],axis), max2 = min2;
+    for(auto& v : p2.vertices) { float d = dot(v,axis); min2 = std::min(min2,d); max2 = std::max(max2,d); }
+    
+    return max1 < min2 || max2 < min1;
+}
+
+// --------------------------------------------------------------------------
+bool findSeparatingAxis(const Polygon& p1, const Polygon& p2, Vec2& out_axis)
+{
+    const Polygon* polys[2] = { &p1, &p2 };
+    for(auto p : polys)
+    {
+        if( p->vertices.empty() ) return false;
+        
+        Vec2 prev = p->vertices[p->vertices.size()-1];
+        for(auto ve : p->vertices)
+        {
+            Vec2 axis = getNormal(prev,ve);
+            if( separatedOnAxis(p1,p2,axis) ) { out_axis = axis; return true; }
+            prev = ve;
+        }
+    }
+    return false;
+}
+
+// --------------------------------------------------------------------------
+bool AABB2AABB(const AABB& b1, const AABB& b2)
+{
+    return b1.min.x <= b2.max.x && b2.min.x <= b1.max.x
+        && b1.min.y <= b2.max.y && b2.min.y <= b1.max.y;
+}
+
 // --------------------------------------------------------------------------
 bool inside(const Vec2& v, const Polygon& p)
 {
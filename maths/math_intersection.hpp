@@ -2,36 +2,48 @@
 #define MATH_INTERSECTION_HPP
 
 #include "math_geometry.hpp"
+#include "math_scratch.hpp"
 
 
+// --------------------------------------------------------------------------
+// results are appended to fixed capacity buffers given by the caller, so the tests never
+// allocate : the capacities below are enough for any input (2 for circles and segments)
+
+// capacity of each buffer of Poly2Poly for polygons of n1 and n2 vertices
+unsigned poly2PolyCapacity(unsigned n1, unsigned n2);
+
+// capacity of the points of Circle2Poly for a polygon of n vertices (the normals need n)
+// the points of each edge hit are appended with those of the edges hit before it
+unsigned circle2PolyCapacity(unsigned n);
+
 // --------------------------------------------------------------------------
 // compute intersection points and normals between 2 circles
-bool Circle2Circle(const Circle& c1, const Circle& c2, Arr<Vec2>& out_p);
+bool Circle2Circle(const Circle& c1, const Circle& c2, VecBuffer& out_p);
 
 // --------------------------------------------------------------------------
 // compute intersection points and normals between edges of 2 polygons (does not detect inner edges)
 // used by Poly2Poly
-bool getIntersectionPoints(const Polygon& p1, const Polygon& p2, Arr<Vec2>& o_p, Arr<Vec2>& o_n1, Arr<Vec2>& o_n2);
+bool getIntersectionPoints(const Polygon& p1, const Polygon& p2, VecBuffer& o_p, VecBuffer& o_n1, VecBuffer& o_n2);
 
 // compute inside points and associated normals between 2 polygons
 // used by Poly2Poly
-bool getInsidePoints(const  Polygon& p1, const Polygon& p2, Arr<Vec2>& o_p, Arr<Vec2>& o_n);
+bool getInsidePoints(const  Polygon& p1, const Polygon& p2, VecBuffer& o_p, VecBuffer& o_n);
 
 // --------------------------------------------------------------------------
 // compute intersection points and normals between 2 polygons
-bool Poly2Poly(const Polygon& p1, const Polygon& p2, Arr<Vec2>& out_p, Arr<Vec2>& out_n1, Arr<Vec2>& out_n2);
+bool Poly2Poly(const Polygon& p1, const Polygon& p2, VecBuffer& out_p, VecBuffer& out_n1, VecBuffer& out_n2);
 
 // --------------------------------------------------------------------------
 // compute intersection points between a circle and a line
-bool Circle2Line(const Circle& c, const Vec2& l1, const Vec2& l2, Arr<Vec2>& out_p);
+bool Circle2Line(const Circle& c, const Vec2& l1, const Vec2& l2, VecBuffer& out_p);
 
 // --------------------------------------------------------------------------
 // compute intersection points between a circle and a Segment
-bool Circle2Seg(const Circle& c, const Vec2& s1, const Vec2& s2, Arr<Vec2>& out_p);
+bool Circle2Seg(const Circle& c, const Vec2& s1, const Vec2& s2, VecBuffer& out_p);
 
 // --------------------------------------------------------------------------
 // compute intersection points and normals between a circle and a polygon
-bool Circle2Poly(const Circle& c, const Polygon& p, Arr<Vec2>& out_p, Arr<Vec2>& out_n);
+bool Circle2Poly(const Circle& c, const Polygon& p, VecBuffer& out_p, VecBuffer& out_n);
 
 // --------------------------------------------------------------------------
 // compute intersection points between 2 segments
@@ -39,7 +51,19 @@ bool Seg2Seg(const Vec2& s1a, const Vec2& s1b, const Vec2& s2a, const Vec2& s2b,
 
 // --------------------------------------------------------------------------
 // compute intersection points between a segment and a polygon
-bool Seg2Poly(const Vec2& sa, const Vec2& sb, const Polygon& p, Arr<Vec2>& out_p, Arr<Vec2>& out_n);
+bool Seg2Poly(const Vec2& sa, const Vec2& sb, const Polygon& p, VecBuffer& out_p, VecBuffer& out_n);
+
+// --------------------------------------------------------------------------
+// test if the projections of 2 polygons on an axis are disjoint
+bool separatedOnAxis(const Polygon& p1, const Polygon& p2, const Vec2& axis);
+
+// --------------------------------------------------------------------------
+// find an edge normal separating 2 convex polygons
+bool findSeparatingAxis(const Polygon& p1, const Polygon& p2, Vec2& out_axis);
+
+// --------------------------------------------------------------------------
+// test if 2 bounding boxes overlap
+bool AABB2AABB(const AABB& b1, const AABB& b2);
 
 // --------------------------------------------------------------------------
 // test if a point v is inside a polygon
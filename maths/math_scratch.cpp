@@ -0,0 +1,60 @@
+#include "math_scratch.hpp"
+#include <algorithm>
+#include <utility>
+
+// --------------------------------------------------------------------------
+ScratchArena::ScratchArena(unsigned s)
+    : block( new char[s] )
+    , size(s)
+    , offset(0)
+{}
+
+// --------------------------------------------------------------------------
+ScratchArena::ScratchArena(ScratchArena&& other) noexcept
+    : block(other.block)
+    , size(other.size)
+    , offset(other.offset)
+    , retired( std::move(other.retired) )
+{
+    other.block = nullptr;
+    other.size = 0;
+    other.offset = 0;
+}
+
+// --------------------------------------------------------------------------
+ScratchArena::~ScratchArena()
+{
+    reset();
+    delete[] block;
+}
+
+// --------------------------------------------------------------------------
+void* ScratchArena::allocate(unsigned bytes, unsigned align)
+{
+    unsigned start = (offset + align-1) & ~(align-1);
+    if(start + bytes > size)
+    {
+        // values already handed out stay valid : the full block is kept until reset
+        retired.push_back(block);
+        size = std::max(size*2, bytes);
+        block = new char[size];
+        start = 0;
+    }
+
+    offset = start + bytes;
+    return block + start;
+}
+
+// --------------------------------------------------------------------------
+void ScratchArena::reset()
+{
+    for(auto b : retired) delete[] b;
+    retired.clear();
+    offset = 0;
+}
+
+// --------------------------------------------------------------------------
+unsigned ScratchArena::capacity() const
+{
+    return size;
+}
@@ -0,0 +1,91 @@
+#ifndef MATH_SCRATCH_HPP
+#define MATH_SCRATCH_HPP
+
+#include "math_vector.hpp"
+
+
+// --------------------------------------------------------------------------
+// bump allocator for temporary results : memory is handed out linearly from one block and
+// released all at once by reset. A full block is replaced by a bigger one (the old one lives
+// until reset), so once the block fits the largest use, no call reaches the heap
+struct ScratchArena
+{
+    // initial block size (bytes)
+    ScratchArena(unsigned size = 4096);
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena(ScratchArena&& other) noexcept;
+    virtual ~ScratchArena();
+
+    // memory for count values of a trivially copyable type (not initialized)
+    template<typename T>
+    T* allocate(unsigned count);
+
+    // align must be a power of 2, at most the alignment of new
+    void* allocate(unsigned bytes, unsigned align);
+
+    // release everything allocated
+    void reset();
+
+    // size of the current block (bytes)
+    unsigned capacity() const;
+
+protected:
+    char* block;
+    unsigned size;
+    unsigned offset;
+
+    // full blocks, freed by reset
+    Arr<char*> retired;
+};
+
+// --------------------------------------------------------------------------
+// fixed capacity array of vectors in memory owned by the caller (an arena, or the stack)
+// values pushed beyond the capacity are dropped
+struct VecBuffer
+{
+    Vec2* data;
+    unsigned count;
+    unsigned capacity;
+
+    VecBuffer(Vec2* storage, unsigned cap);
+    VecBuffer(ScratchArena& arena, unsigned cap);
+
+    void push_back(const Vec2& v);
+    void clear();
+
+    unsigned size() const;
+    bool empty() const;
+
+    Vec2& operator[](unsigned i);
+    const Vec2& operator[](unsigned i) const;
+
+    const Vec2* begin() const;
+    const Vec2* end() const;
+};
+
+
+
+// --------------------------------------------------------------------------
+template<typename T>
+inline T* ScratchArena::allocate(unsigned count)
+{
+    return static_cast<T*>( allocate(count * sizeof(T), alignof(T)) );
+}
+
+inline VecBuffer::VecBuffer(Vec2* storage, unsigned cap) : data(storage), count(0), capacity(cap) {}
+inline VecBuffer::VecBuffer(ScratchArena& arena, unsigned cap) : data( arena.allocate<Vec2>(cap) ), count(0), capacity(cap) {}
+
+inline void VecBuffer::push_back(const Vec2& v) { if(count < capacity) data[count++] = v; }
+inline void VecBuffer::clear() { count = 0; }
+
+inline unsigned VecBuffer::size() const { return count; }
+inline bool VecBuffer::empty() const { return count == 0; }
+
+inline Vec2& VecBuffer::operator[](unsigned i) { return data[i]; }
+inline const Vec2& VecBuffer::operator[](unsigned i) const { return data[i]; }
+
+inline const Vec2* VecBuffer::begin() const { return data; }
+inline const Vec2* VecBuffer::end() const { return data + count; }
+
+
+#endif // MATH_SCRATCH_HPP
@@ -1,6 +1,39 @@
 #include "math_vector.hpp"
 #include <cmath>
 
+// --------------------------------------------------------------------------
+Transform::Transform()
+{
+    m[0] = 1.f; m[1] = 0.f; m[2] = 0.f;
+    m[3] = 0.f; m[4] = 1.f; m[5] = 0.f;
+}
+
+// --------------------------------------------------------------------------
+Transform& Transform::rotate(float angle)
+{
+    float rad = angle * 3.141592654f / 180.f;
+    float c = std::cos(rad);
+    float s = std::sin(rad);
+
+    // this * [c -s ; s c]
+    float a = m[0], b = m[1], d = m[3], e = m[4];
+    m[0] = a*c + b*s; m[1] = a*-s + b*c;
+    m[3] = d*c + e*s; m[4] = d*-s + e*c;
+    return *this;
+}
+
+// --------------------------------------------------------------------------
+Vec2 Transform::transformPoint(const Vec2& p) const
+{
+    return Vec2( m[0]*p.x + m[1]*p.y + m[2], m[3]*p.x + m[4]*p.y + m[5] );
+}
+
+// --------------------------------------------------------------------------
+Vec2 operator*(const Transform& t, const Vec2& p)
+{
+    return t.transformPoint(p);
+}
+
 // --------------------------------------------------------------------------
 float dot( const Vec2& v1, const Vec2& v2 )
 {
@@ -2,14 +2,56 @@
 #define MATH_VECTOR_INCLUDED
 
 #include <vector>
-#include <SFML/Graphics.hpp>
 
 // --------------------------------------------------------------------------
 // Alias
-using Vec2 = sf::Vector2f;
 template<typename T>
 using Arr = std::vector<T>;
 
+// --------------------------------------------------------------------------
+// 2d float vector (same layout and arithmetic as sf::Vector2f, which renderers convert to)
+struct Vec2
+{
+    float x;
+    float y;
+
+    Vec2() : x(0.f), y(0.f) {}
+    Vec2(float vx, float vy) : x(vx), y(vy) {}
+};
+
+inline Vec2 operator-(const Vec2& v) { return Vec2(-v.x, -v.y); }
+inline Vec2 operator+(const Vec2& v1, const Vec2& v2) { return Vec2(v1.x+v2.x, v1.y+v2.y); }
+inline Vec2 operator-(const Vec2& v1, const Vec2& v2) { return Vec2(v1.x-v2.x, v1.y-v2.y); }
+inline Vec2 operator*(const Vec2& v, float f) { return Vec2(v.x*f, v.y*f); }
+inline Vec2 operator*(float f, const Vec2& v) { return Vec2(v.x*f, v.y*f); }
+inline Vec2 operator/(const Vec2& v, float f) { return Vec2(v.x/f, v.y/f); }
+
+inline Vec2& operator+=(Vec2& v1, const Vec2& v2) { v1.x+=v2.x; v1.y+=v2.y; return v1; }
+inline Vec2& operator-=(Vec2& v1, const Vec2& v2) { v1.x-=v2.x; v1.y-=v2.y; return v1; }
+inline Vec2& operator*=(Vec2& v, float f) { v.x*=f; v.y*=f; return v; }
+inline Vec2& operator/=(Vec2& v, float f) { v.x/=f; v.y/=f; return v; }
+
+inline bool operator==(const Vec2& v1, const Vec2& v2) { return v1.x==v2.x && v1.y==v2.y; }
+inline bool operator!=(const Vec2& v1, const Vec2& v2) { return !(v1==v2); }
+
+// --------------------------------------------------------------------------
+// 2d affine transform (rows of a 2x3 matrix)
+struct Transform
+{
+    float m[6];
+
+    // identity
+    Transform();
+
+    // combine with a rotation (in degrees, like sf::Transform)
+    Transform& rotate(float angle);
+
+    // apply on a point
+    Vec2 transformPoint(const Vec2& p) const;
+};
+
+Vec2 operator*(const Transform& t, const Vec2& p);
+
 
 // --------------------------------------------------------------------------
 // dot product
@@ -0,0 +1,197 @@
+#include "physic_body.hpp"
+#include "physic_entity.hpp"
+
+// --------------------------------------------------------------------------
+BodyHandle::BodyHandle() : store(nullptr), index(~0u), generation(0) {}
+
+// --------------------------------------------------------------------------
+BodyHandle::BodyHandle(const BodyStore* s, unsigned i, unsigned g) : store(s), index(i), generation(g) {}
+
+// --------------------------------------------------------------------------
+bool BodyHandle::operator==(const BodyHandle& h) const
+{
+    return store == h.store && index == h.index && generation == h.generation;
+}
+
+// --------------------------------------------------------------------------
+bool BodyHandle::operator!=(const BodyHandle& h) const { return !(*this == h); }
+
+
+
+// --------------------------------------------------------------------------
+BodyStore::BodyStore(bool guarded)
+    : guard( guarded ? new std::mutex() : nullptr )
+{}
+
+// --------------------------------------------------------------------------
+BodyStore::~BodyStore()
+{
+    delete guard;
+}
+
+// --------------------------------------------------------------------------
+unsigned BodyStore::size() const
+{
+    return owner.size();
+}
+
+// --------------------------------------------------------------------------
+// lock of a store if it is guarded
+std::unique_lock<std::mutex> lockStore(std::mutex* guard)
+{
+    if(guard == nullptr) return std::unique_lock<std::mutex>();
+    return std::unique_lock<std::mutex>(*guard);
+}
+
+// --------------------------------------------------------------------------
+unsigned BodyStore::create(Entity* e, const Vec2& p, float m, float r, float f)
+{
+    auto lock = lockStore(guard);
+    return createSlot(e, p, m, r, f);
+}
+
+// --------------------------------------------------------------------------
+void BodyStore::release(unsigned slot)
+{
+    auto lock = lockStore(guard);
+    releaseSlot(slot);
+}
+
+// --------------------------------------------------------------------------
+unsigned BodyStore::createSlot(Entity* e, const Vec2& p, float m, float r, float f)
+{
+    unsigned slot = owner.size();
+
+    unsigned h;
+    if( !freeHandles.empty() )
+    {
+        h = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    else
+    {
+        h = handleSlot.size();
+        handleSlot.push_back(0);
+        generation.push_back(0);
+    }
+    handleSlot[h] = slot;
+
+    position.push_back(p);
+    rotation.push_back(0.f);
+    v_linear.push_back(Vec2(0.f,0.f));
+    v_angular.push_back(0.f);
+    mass.push_back(m);
+    restitution.push_back(r);
+    friction.push_back(f);
+    previousPosition.push_back(p);
+    previousRotation.push_back(0.f);
+    sleepGroup.push_back(0);
+    restTime.push_back(0.f);
+    meanLinear.push_back(Vec2(0.f,0.f));
+    meanAngular.push_back(0.f);
+    owner.push_back(e);
+    handleIndex.push_back(h);
+
+    return slot;
+}
+
+// --------------------------------------------------------------------------
+void BodyStore::releaseSlot(unsigned slot)
+{
+    // the handle becomes stale
+    unsigned h = handleIndex[slot];
+    generation[h]++;
+    freeHandles.push_back(h);
+
+    // keep the arrays dense : the last body fills the hole
+    unsigned last = owner.size()-1;
+    if(slot != last)
+    {
+        position[slot] = position[last];
+        rotation[slot] = rotation[last];
+        v_linear[slot] = v_linear[last];
+        v_angular[slot] = v_angular[last];
+        mass[slot] = mass[last];
+        restitution[slot] = restitution[last];
+        friction[slot] = friction[last];
+        previousPosition[slot] = previousPosition[last];
+        previousRotation[slot] = previousRotation[last];
+        sleepGroup[slot] = sleepGroup[last];
+        restTime[slot] = restTime[last];
+        meanLinear[slot] = meanLinear[last];
+        meanAngular[slot] = meanAngular[last];
+        owner[slot] = owner[last];
+        handleIndex[slot] = handleIndex[last];
+
+        handleSlot[ handleIndex[slot] ] = slot;
+        owner[slot]->bodySlot = slot;
+    }
+
+    position.pop_back();
+    rotation.pop_back();
+    v_linear.pop_back();
+    v_angular.pop_back();
+    mass.pop_back();
+    restitution.pop_back();
+    friction.pop_back();
+    previousPosition.pop_back();
+    previousRotation.pop_back();
+    sleepGroup.pop_back();
+    restTime.pop_back();
+    meanLinear.pop_back();
+    meanAngular.pop_back();
+    owner.pop_back();
+    handleIndex.pop_back();
+}
+
+// --------------------------------------------------------------------------
+void BodyStore::adopt(Entity* e)
+{
+    BodyStore* from = e->store;
+    if(from == this) return;
+
+    // at most one of them is the shared store
+    auto lockFrom = lockStore(from->guard);
+    auto lockTo = lockStore(guard);
+
+    unsigned s = e->bodySlot;
+    unsigned slot = createSlot(e, from->position[s], from->mass[s], from->restitution[s], from->friction[s]);
+    rotation[slot] = from->rotation[s];
+    v_linear[slot] = from->v_linear[s];
+    v_angular[slot] = from->v_angular[s];
+    previousPosition[slot] = from->previousPosition[s];
+    previousRotation[slot] = from->previousRotation[s];
+    meanLinear[slot] = from->meanLinear[s];
+    meanAngular[slot] = from->meanAngular[s];
+
+    from->releaseSlot(s);
+    e->store = this;
+    e->bodySlot = slot;
+}
+
+// --------------------------------------------------------------------------
+BodyHandle BodyStore::handle(unsigned slot) const
+{
+    unsigned h = handleIndex[slot];
+    return BodyHandle(this, h, generation[h]);
+}
+
+// --------------------------------------------------------------------------
+bool BodyStore::valid(BodyHandle h) const
+{
+    return h.store == this && h.index < generation.size() && generation[h.index] == h.generation;
+}
+
+// --------------------------------------------------------------------------
+Entity* BodyStore::get(BodyHandle h) const
+{
+    if( !valid(h) ) return nullptr;
+    return owner[ handleSlot[h.index] ];
+}
+
+// --------------------------------------------------------------------------
+BodyStore& BodyStore::shared()
+{
+    static BodyStore store(true);
+    return store;
+}
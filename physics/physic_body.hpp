@@ -0,0 +1,103 @@
+#ifndef PHYSIC_BODY_HPP
+#define PHYSIC_BODY_HPP
+
+#include "../maths/math_vector.hpp"
+#include <mutex>
+
+struct Entity;
+struct BodyStore;
+
+
+// --------------------------------------------------------------------------
+// stable reference to a body, detects bodies which have been destroyed
+// a handle belongs to the store which issued it, the other stores reject it
+struct BodyHandle
+{
+    const BodyStore* store;
+    unsigned index;
+    unsigned generation;
+
+    BodyHandle();
+    BodyHandle(const BodyStore* s, unsigned i, unsigned g);
+
+    bool operator==(const BodyHandle& h) const;
+    bool operator!=(const BodyHandle& h) const;
+};
+
+// --------------------------------------------------------------------------
+// physical state of the bodies, one contiguous array per field
+// slots are kept dense (a released slot is filled with the last body),
+// so integration runs as linear sweeps
+struct BodyStore
+{
+    // per slot data
+    Arr<Vec2> position;
+    Arr<float> rotation;
+    Arr<Vec2> v_linear;
+    Arr<float> v_angular;
+    Arr<float> mass;
+    Arr<float> restitution;
+    Arr<float> friction;
+
+    // pose before the last step, for drawing between 2 steps and for the rest test
+    Arr<Vec2> previousPosition;
+    Arr<float> previousRotation;
+
+    // sleeping island of the body (0 if awake), and time spent under the sleep velocities (seconds)
+    Arr<unsigned> sleepGroup;
+    Arr<float> restTime;
+
+    // moves of the last steps averaged, for the rest test (a resting body jitters)
+    Arr<Vec2> meanLinear;
+    Arr<float> meanAngular;
+
+    // facade entity and handle index of each slot
+    Arr<Entity*> owner;
+    Arr<unsigned> handleIndex;
+
+    // handle table : slot and generation of each handle index
+    Arr<unsigned> handleSlot;
+    Arr<unsigned> generation;
+    Arr<unsigned> freeHandles;
+
+    // guarded : create, release and adopt are serialized (for a store used by several threads)
+    BodyStore(bool guarded = false);
+    BodyStore(const BodyStore&) = delete;
+    virtual ~BodyStore();
+
+    // number of bodies
+    unsigned size() const;
+
+    // add a body for entity e and return its slot
+    unsigned create(Entity* e, const Vec2& p, float m, float r, float f);
+
+    // remove the body of a slot (the last body is moved into it)
+    void release(unsigned slot);
+
+    // move the body of e from its current store into this one
+    void adopt(Entity* e);
+
+    // handle of a slot
+    BodyHandle handle(unsigned slot) const;
+
+    // test if a handle was issued by this store and still refers to a body
+    bool valid(BodyHandle h) const;
+
+    // entity of a handle (null if destroyed)
+    Entity* get(BodyHandle h) const;
+
+    // guarded store of the bodies of unregistered entities (engines own the bodies of their entities)
+    // creating and destroying entities is thread safe, but the fields of an unregistered
+    // entity may move meanwhile : set them through the constructor, or once registered
+    static BodyStore& shared();
+
+protected:
+    // lock of a guarded store (null otherwise)
+    std::mutex* guard;
+
+    unsigned createSlot(Entity* e, const Vec2& p, float m, float r, float f);
+    void releaseSlot(unsigned slot);
+};
+
+
+#endif // PHYSIC_BODY_HPP
@@ -0,0 +1,640 @@
+#include "physic_broadphase.hpp"
+#include "../maths/math_intersection.hpp"
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+// --------------------------------------------------------------------------
+Broadphase::Broadphase()
+    : filteredPairs(0)
+{}
+
+// --------------------------------------------------------------------------
+Broadphase::~Broadphase() {}
+
+// --------------------------------------------------------------------------
+void Broadphase::reserve(unsigned) {}
+
+// --------------------------------------------------------------------------
+void expandBodies(Entity* e, Arr<Entity*>& out_bodies)
+{
+    if(e->shape == SHAPE_GROUP)
+    {
+        for(auto& e2 : static_cast<GroupEntity*>(e)->entities) expandBodies(e2, out_bodies);
+    }
+    else
+    {
+        out_bodies.push_back(e);
+    }
+}
+
+// --------------------------------------------------------------------------
+bool Broadphase::collectBodies(const Arr<Entity*>& entities)
+{
+    bodies.clear();
+    for(auto& e : entities) expandBodies(e, bodies);
+
+    boxes.resize(bodies.size());
+    for(unsigned i=0; i<bodies.size(); ++i) getBounds(*bodies[i], boxes[i]);
+
+    bool changed = (bodies != prevBodies);
+    if(changed) prevBodies = bodies;
+    return changed;
+}
+
+// --------------------------------------------------------------------------
+void Broadphase::emitPair(unsigned i, unsigned j, Arr<EntityPair>& out_pairs, unsigned& filtered) const
+{
+    EntityPair p;
+    if( makePair(bodies[std::min(i,j)], bodies[std::max(i,j)], p, filtered) ) out_pairs.push_back(p);
+}
+
+// --------------------------------------------------------------------------
+bool acceptPair(const Entity& e1, const Entity& e2)
+{
+    if(e1.mass() == 0.f && e2.mass() == 0.f) return false;
+    if(e1.parent != nullptr && e1.parent == e2.parent) return false;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+bool makePair(Entity* e1, Entity* e2, EntityPair& out_pair, unsigned& filtered)
+{
+    if( !acceptPair(*e1,*e2) ) return false;
+    if( !shouldCollide(*e1,*e2) ) { filtered++; return false; }
+
+    out_pair.e1 = e1;
+    out_pair.e2 = e2;
+    return true;
+}
+
+
+
+// --------------------------------------------------------------------------
+SweepAndPrune::SweepAndPrune() {}
+
+// --------------------------------------------------------------------------
+SweepAndPrune::~SweepAndPrune() {}
+
+// --------------------------------------------------------------------------
+void SweepAndPrune::update(const Arr<Entity*>& entities)
+{
+    if( collectBodies(entities) )
+    {
+        axisX.resize(bodies.size());
+        for(unsigned i=0; i<axisX.size(); ++i) axisX[i] = i;
+        std::sort(axisX.begin(), axisX.end(), [this](unsigned a, unsigned b)
+        {
+            return boxes[a].min.x < boxes[b].min.x;
+        });
+        return;
+    }
+
+    // insertion sort : bodies move a little between steps
+    for(unsigned i=1; i<axisX.size(); ++i)
+    {
+        unsigned id = axisX[i];
+        float key = boxes[id].min.x;
+        unsigned j = i;
+        while(j>0 && boxes[axisX[j-1]].min.x > key)
+        {
+            axisX[j] = axisX[j-1];
+            --j;
+        }
+        axisX[j] = id;
+    }
+}
+
+// --------------------------------------------------------------------------
+void SweepAndPrune::findPairs(Arr<EntityPair>& out_pairs)
+{
+    filteredPairs = 0;
+    for(unsigned i=0; i<axisX.size(); ++i)
+    {
+        const AABB& b1 = boxes[axisX[i]];
+        for(unsigned j=i+1; j<axisX.size(); ++j)
+        {
+            const AABB& b2 = boxes[axisX[j]];
+            if(b2.min.x > b1.max.x) break;
+            if(b2.min.y > b1.max.y || b1.min.y > b2.max.y) continue;
+
+            emitPair(axisX[i], axisX[j], out_pairs, filteredPairs);
+        }
+    }
+}
+
+
+
+// --------------------------------------------------------------------------
+GridBroadphase::GridBroadphase(float cs)
+    : cellSize(cs)
+    , bucketCount(0)
+{}
+
+// --------------------------------------------------------------------------
+GridBroadphase::~GridBroadphase() {}
+
+// --------------------------------------------------------------------------
+unsigned GridBroadphase::hashCell(int cx, int cy) const
+{
+    unsigned h = (unsigned)cx * 73856093u ^ (unsigned)cy * 19349663u;
+    return h & (bucketCount-1);
+}
+
+// --------------------------------------------------------------------------
+int GridBroadphase::cellCoord(float v) const
+{
+    return (int)std::floor(v / cellSize);
+}
+
+// --------------------------------------------------------------------------
+void GridBroadphase::update(const Arr<Entity*>& entities)
+{
+    // a body smaller than a cell overlaps 4 cells at most, and has about two buckets per cell
+    if( collectBodies(entities) )
+    {
+        unsigned reserved = bodies.size()*4;
+        entries.reserve(reserved);
+        buckets.reserve(reserved);
+        
+        unsigned wanted = 16;
+        while(wanted < reserved*2) wanted *= 2;
+        bucketStart.reserve(wanted+1);
+    }
+
+    entries.clear();
+    for(unsigned i=0; i<bodies.size(); ++i)
+    {
+        const AABB& b = boxes[i];
+        int x0 = cellCoord(b.min.x), x1 = cellCoord(b.max.x);
+        int y0 = cellCoord(b.min.y), y1 = cellCoord(b.max.y);
+        for(int cy=y0; cy<=y1; ++cy)
+            for(int cx=x0; cx<=x1; ++cx) entries.push_back( {cx,cy,i} );
+    }
+
+    // power of two bucket count, about two buckets per entry
+    unsigned wanted = 16;
+    while(wanted < entries.size()*2) wanted *= 2;
+    if(wanted > bucketCount) bucketCount = wanted;
+
+    // counting sort of the entries by bucket
+    bucketStart.assign(bucketCount+1, 0);
+    for(auto& en : entries) bucketStart[hashCell(en.cx,en.cy)+1]++;
+    for(unsigned k=0; k<bucketCount; ++k) bucketStart[k+1] += bucketStart[k];
+
+    buckets.resize(entries.size());
+    for(auto& en : entries)
+    {
+        unsigned k = hashCell(en.cx,en.cy);
+        buckets[bucketStart[k]++] = en;
+    }
+
+    // scattering has shifted each start to the next bucket
+    for(unsigned k=bucketCount; k>0; --k) bucketStart[k] = bucketStart[k-1];
+    bucketStart[0] = 0;
+}
+
+// --------------------------------------------------------------------------
+void GridBroadphase::findPairs(Arr<EntityPair>& out_pairs)
+{
+    filteredPairs = 0;
+    for(unsigned k=0; k<bucketCount; ++k)
+    {
+        unsigned end = bucketStart[k+1];
+        for(unsigned a=bucketStart[k]; a<end; ++a)
+        {
+            const Entry& en1 = buckets[a];
+            const AABB& b1 = boxes[en1.body];
+            for(unsigned b=a+1; b<end; ++b)
+            {
+                const Entry& en2 = buckets[b];
+                if(en1.cx != en2.cx || en1.cy != en2.cy) continue;
+
+                const AABB& b2 = boxes[en2.body];
+                if( !AABB2AABB(b1,b2) ) continue;
+
+                // a pair sharing several cells is only emitted from the cell holding the min corner of the overlap
+                int ox = cellCoord( std::max(b1.min.x,b2.min.x) );
+                int oy = cellCoord( std::max(b1.min.y,b2.min.y) );
+                if(ox != en1.cx || oy != en1.cy) continue;
+
+                emitPair(en1.body, en2.body, out_pairs, filteredPairs);
+            }
+        }
+    }
+}
+
+
+
+// --------------------------------------------------------------------------
+TreeBroadphase::TreeBroadphase(float margin)
+    : tree(margin)
+{}
+
+// --------------------------------------------------------------------------
+TreeBroadphase::~TreeBroadphase() {}
+
+// --------------------------------------------------------------------------
+void TreeBroadphase::update(const Arr<Entity*>& entities)
+{
+    if( collectBodies(entities) )
+    {
+        tree.clear();
+        leaves.resize(bodies.size());
+        for(unsigned i=0; i<bodies.size(); ++i) leaves[i] = tree.insert(boxes[i], i);
+        return;
+    }
+
+    for(unsigned i=0; i<bodies.size(); ++i) tree.move(leaves[i], boxes[i]);
+}
+
+// --------------------------------------------------------------------------
+void TreeBroadphase::findPairs(Arr<EntityPair>& out_pairs)
+{
+    filteredPairs = 0;
+    treePairs.clear();
+    tree.findPairs(treePairs);
+
+    // fat boxes overlap more often than the real ones
+    for(auto& p : treePairs)
+    {
+        if( AABB2AABB(boxes[p.first], boxes[p.second]) ) emitPair(p.first, p.second, out_pairs, filteredPairs);
+    }
+}
+
+// --------------------------------------------------------------------------
+// the fat boxes find more pairs than the real ones : twice the expected pairs
+void TreeBroadphase::reserve(unsigned pairCount)
+{
+    treePairs.reserve(pairCount * 2);
+}
+
+// --------------------------------------------------------------------------
+void TreeBroadphase::query(const AABB& box, Arr<Entity*>& out_bodies)
+{
+    queryRes.clear();
+    tree.query(box, queryRes);
+    for(auto i : queryRes)
+    {
+        if( AABB2AABB(boxes[i], box) ) out_bodies.push_back(bodies[i]);
+    }
+}
+
+
+
+// --------------------------------------------------------------------------
+// spread the 16 low bits of v on even bits
+unsigned expandBits(unsigned v)
+{
+    v &= 0x0000ffff;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+// --------------------------------------------------------------------------
+int countLeadingZeros(unsigned v)
+{
+    if(v == 0) return 32;
+#if defined(__GNUC__)
+    return __builtin_clz(v);
+#else
+    int n = 0;
+    while( (v & 0x80000000u) == 0 ) { v <<= 1; ++n; }
+    return n;
+#endif
+}
+
+// --------------------------------------------------------------------------
+LinearBVHBroadphase::LinearBVHBroadphase(ThreadPool* p)
+    : pool(p)
+    , ownPool(p == nullptr)
+{
+    if(ownPool) pool = new ThreadPool(1);
+}
+
+// --------------------------------------------------------------------------
+LinearBVHBroadphase::~LinearBVHBroadphase()
+{
+    if(ownPool) delete pool;
+}
+
+// --------------------------------------------------------------------------
+int LinearBVHBroadphase::delta(int i, int j) const
+{
+    int n = codes.size();
+    if(j < 0 || j >= n) return -1;
+    
+    // equal codes : the position in the sorted list breaks the tie
+    if(codes[i] == codes[j]) return 32 + countLeadingZeros( (unsigned)i ^ (unsigned)j );
+    return countLeadingZeros( codes[i] ^ codes[j] );
+}
+
+// --------------------------------------------------------------------------
+void LinearBVHBroadphase::radixSort()
+{
+    unsigned n = codes.size();
+    unsigned chunks = (n + GRAIN - 1) / GRAIN;
+    tmpCodes.resize(n);
+    tmpOrder.resize(n);
+    histograms.resize(chunks * 256);
+    
+    for(unsigned shift=0; shift<32; shift+=8)
+    {
+        // digit count of each chunk
+        pool->parallelFor(n, GRAIN, [&](unsigned b, unsigned e)
+        {
+            unsigned* h = &histograms[ (b/GRAIN) * 256 ];
+            for(unsigned d=0; d<256; ++d) h[d] = 0;
+            for(unsigned i=b; i<e; ++i) h[ (codes[i] >> shift) & 0xff ]++;
+        });
+        
+        // first slot of each (digit, chunk), digit major so the sort stays stable
+        unsigned sum = 0;
+        for(unsigned d=0; d<256; ++d)
+        {
+            for(unsigned c=0; c<chunks; ++c)
+            {
+                unsigned count = histograms[c*256+d];
+                histograms[c*256+d] = sum;
+                sum += count;
+            }
+        }
+        
+        pool->parallelFor(n, GRAIN, [&](unsigned b, unsigned e)
+        {
+            unsigned* h = &histograms[ (b/GRAIN) * 256 ];
+            for(unsigned i=b; i<e; ++i)
+            {
+                unsigned slot = h[ (codes[i] >> shift) & 0xff ]++;
+                tmpCodes[slot] = codes[i];
+                tmpOrder[slot] = order[i];
+            }
+        });
+        
+        codes.swap(tmpCodes);
+        order.swap(tmpOrder);
+    }
+}
+
+// --------------------------------------------------------------------------
+void LinearBVHBroadphase::buildNode(int i)
+{
+    int n = codes.size();
+    
+    // direction of the range covered by node i
+    int d = delta(i,i+1) > delta(i,i-1) ? 1 : -1;
+    int dmin = delta(i,i-d);
+    
+    // upper bound of the range length, then binary search of its end
+    int lmax = 2;
+    while( delta(i, i+lmax*d) > dmin ) lmax *= 2;
+    int l = 0;
+    for(int t=lmax/2; t>=1; t/=2)
+    {
+        if( delta(i, i+(l+t)*d) > dmin ) l += t;
+    }
+    int j = i + l*d;
+    
+    // split position : highest differing bit in the range
+    int dnode = delta(i,j);
+    int s = 0;
+    int t = l;
+    do
+    {
+        t = (t+1) / 2;
+        if( delta(i, i+(s+t)*d) > dnode ) s += t;
+    }
+    while(t > 1);
+    int split = i + s*d + std::min(d,0);
+    
+    int first = std::min(i,j);
+    int last = std::max(i,j);
+    
+    Node& node = nodes[i];
+    node.child1 = (first == split) ? (n-1) + split : split;
+    node.child2 = (last == split+1) ? (n-1) + split+1 : split+1;
+    node.rangeEnd = last;
+    nodes[node.child1].parent = i;
+    nodes[node.child2].parent = i;
+}
+
+// --------------------------------------------------------------------------
+void LinearBVHBroadphase::update(const Arr<Entity*>& entities)
+{
+    collectBodies(entities);
+    
+    unsigned n = bodies.size();
+    codes.resize(n);
+    order.resize(n);
+    if(n < 2) return;
+    
+    // scene bounds of the box centers
+    AABB scene( (boxes[0].min+boxes[0].max)*0.5f, (boxes[0].min+boxes[0].max)*0.5f );
+    for(auto& b : boxes) scene.extend( (b.min+b.max)*0.5f );
+    Vec2 size = scene.max - scene.min;
+    
+    // origin and scale of the quantization, captured as one reference : a job capturing more
+    // than 2 pointers does not fit in std::function and would be allocated at each step
+    struct Quantization { Vec2 origin; Vec2 scale; };
+    Quantization q = { scene.min, Vec2( size.x > 0.f ? 65535.f / size.x : 0.f, size.y > 0.f ? 65535.f / size.y : 0.f ) };
+    
+    pool->parallelFor(n, GRAIN, [this, &q](unsigned b, unsigned e)
+    {
+        for(unsigned i=b; i<e; ++i)
+        {
+            Vec2 c = (boxes[i].min+boxes[i].max)*0.5f - q.origin;
+            unsigned qx = (unsigned)(c.x * q.scale.x);
+            unsigned qy = (unsigned)(c.y * q.scale.y);
+            codes[i] = (expandBits(qy) << 1) | expandBits(qx);
+            order[i] = i;
+        }
+    });
+    
+    radixSort();
+    
+    // leaves
+    nodes.resize(2*n-1);
+    nodes[0].parent = -1;
+    pool->parallelFor(n, GRAIN, [&](unsigned b, unsigned e)
+    {
+        for(unsigned k=b; k<e; ++k)
+        {
+            Node& leaf = nodes[n-1+k];
+            leaf.box = boxes[ order[k] ];
+            leaf.child1 = -1;
+            leaf.child2 = -1;
+            leaf.rangeEnd = k;
+        }
+    });
+    
+    // internal nodes
+    pool->parallelFor(n-1, GRAIN, [&](unsigned b, unsigned e)
+    {
+        for(unsigned i=b; i<e; ++i) buildNode(i);
+    });
+    
+    // internal boxes, from the leaves up to the root
+    if(visits.size() < n-1) visits = Arr< std::atomic<int> >(n-1);
+    for(unsigned i=0; i<n-1; ++i) visits[i].store(0, std::memory_order_relaxed);
+    
+    pool->parallelFor(n, GRAIN, [&](unsigned b, unsigned e)
+    {
+        for(unsigned k=b; k<e; ++k)
+        {
+            int id = nodes[n-1+k].parent;
+            while(id != -1)
+            {
+                // the first child to arrive leaves the work to its sibling
+                if( visits[id].fetch_add(1, std::memory_order_acq_rel) == 0 ) break;
+                
+                Node& node = nodes[id];
+                node.box = nodes[node.child1].box;
+                node.box.extend( nodes[node.child2].box );
+                id = node.parent;
+            }
+        }
+    });
+}
+
+// --------------------------------------------------------------------------
+void LinearBVHBroadphase::findPairs(Arr<EntityPair>& out_pairs)
+{
+    filteredPairs = 0;
+    unsigned n = codes.size();
+    if(n < 2) return;
+    
+    unsigned chunks = (n + GRAIN - 1) / GRAIN;
+    if(chunkPairs.size() < chunks)
+    {
+        // a leaf has a few pairs with the leaves after it, so a chunk does not grow at each step
+        unsigned first = chunkPairs.size();
+        chunkPairs.resize(chunks);
+        for(unsigned c=first; c<chunks; ++c) chunkPairs[c].reserve(GRAIN * 4);
+    }
+    chunkFiltered.resize(chunks);
+    
+    // each leaf looks for the leaves after it in sorted order
+    pool->parallelFor(n, GRAIN, [&](unsigned b, unsigned e)
+    {
+        Arr<EntityPair>& res = chunkPairs[b/GRAIN];
+        unsigned& filtered = chunkFiltered[b/GRAIN];
+        res.clear();
+        filtered = 0;
+        
+        int stack[128];
+        for(unsigned k=b; k<e; ++k)
+        {
+            const AABB& box = nodes[n-1+k].box;
+            int top = 0;
+            stack[top++] = 0;
+            while(top > 0)
+            {
+                const Node& node = nodes[ stack[--top] ];
+                if(node.rangeEnd <= k || !AABB2AABB(node.box, box)) continue;
+                
+                if(node.child1 == -1)
+                {
+                    emitPair(order[k], order[node.rangeEnd], res, filtered);
+                }
+                else
+                {
+                    stack[top++] = node.child1;
+                    stack[top++] = node.child2;
+                }
+            }
+        }
+    });
+    
+    for(unsigned c=0; c<chunks; ++c)
+    {
+        out_pairs.insert(out_pairs.end(), chunkPairs[c].begin(), chunkPairs[c].end());
+        filteredPairs += chunkFiltered[c];
+    }
+}
+
+
+
+// --------------------------------------------------------------------------
+StaticGeometry::StaticGeometry()
+    : tree(0.f)
+    , filteredPairs(0)
+{}
+
+// --------------------------------------------------------------------------
+StaticGeometry::~StaticGeometry() {}
+
+// --------------------------------------------------------------------------
+// entries of the static lookup ordered by entity (std::less : the bodies are not in one array)
+bool lookupLess(const std::pair<const Entity*,unsigned>& a, const std::pair<const Entity*,unsigned>& b)
+{
+    return std::less<const Entity*>()(a.first, b.first);
+}
+
+// --------------------------------------------------------------------------
+void StaticGeometry::add(Entity* e)
+{
+    unsigned first = bodies.size();
+    expandBodies(e, bodies);
+
+    boxes.resize(bodies.size());
+    for(unsigned i=first; i<bodies.size(); ++i)
+    {
+        // static polygons are placed once and for all
+        if(bodies[i]->shape == SHAPE_RECT)
+        {
+            RectEntity* re = static_cast<RectEntity*>(bodies[i]);
+            re->change(); re->update();
+        }
+
+        getBounds(*bodies[i], boxes[i]);
+        tree.insert(boxes[i], i);
+        lookup.push_back( std::make_pair(bodies[i], i) );
+    }
+    std::sort(lookup.begin(), lookup.end(), lookupLess);
+    
+    // a query never finds more : findPairs does not allocate
+    hits.reserve(bodies.size());
+}
+
+// --------------------------------------------------------------------------
+void StaticGeometry::clear()
+{
+    bodies.clear();
+    boxes.clear();
+    tree.clear();
+    lookup.clear();
+}
+
+// --------------------------------------------------------------------------
+unsigned StaticGeometry::indexOf(const Entity* e) const
+{
+    auto it = std::lower_bound(lookup.begin(), lookup.end(), std::make_pair(e, 0u), lookupLess);
+    if( it == lookup.end() || it->first != e ) return ~0u;
+    return it->second;
+}
+
+// --------------------------------------------------------------------------
+void StaticGeometry::query(const AABB& box, Arr<unsigned>& out_bodies) const
+{
+    tree.query(box, out_bodies);
+}
+
+// --------------------------------------------------------------------------
+void StaticGeometry::findPairs(const Arr<Entity*>& dynBodies, const Arr<AABB>& dynBoxes, Arr<EntityPair>& out_pairs)
+{
+    filteredPairs = 0;
+    for(unsigned i=0; i<dynBodies.size(); ++i)
+    {
+        hits.clear();
+        tree.query(dynBoxes[i], hits);
+
+        EntityPair p;
+        for(auto k : hits)
+        {
+            if( makePair(dynBodies[i], bodies[k], p, filteredPairs) ) out_pairs.push_back(p);
+        }
+    }
+}
@@ -0,0 +1,248 @@
+#ifndef PHYSIC_BROADPHASE_HPP
+#define PHYSIC_BROADPHASE_HPP
+
+#include "physic_entity.hpp"
+#include "../maths/math_aabbtree.hpp"
+#include "physic_threadpool.hpp"
+
+
+// --------------------------------------------------------------------------
+// candidate pair given to the narrowphase
+struct EntityPair
+{
+    Entity* e1;
+    Entity* e2;
+};
+
+// --------------------------------------------------------------------------
+// base interface of the collision pair finders
+struct Broadphase
+{
+    // collidable entities (group children are expanded)
+    Arr<Entity*> bodies;
+
+    // bounding box of each body
+    Arr<AABB> boxes;
+
+    // pairs rejected by collision filtering during the last findPairs
+    unsigned filteredPairs;
+
+    Broadphase();
+    virtual ~Broadphase();
+
+    // refresh the internal structure with the registered entities
+    virtual void update(const Arr<Entity*>& entities) = 0;
+
+    // append each pair of bodies with overlapping bounds (only once per pair)
+    virtual void findPairs(Arr<EntityPair>& out_pairs) = 0;
+    
+    // capacity of the internal pair buffers, for pairCount pairs (nothing by default)
+    virtual void reserve(unsigned pairCount);
+
+protected:
+    // expand entities into bodies and compute their bounds
+    // return true if the body list changed since the last call
+    bool collectBodies(const Arr<Entity*>& entities);
+
+    // filter pair (i,j) and append it in canonical order
+    void emitPair(unsigned i, unsigned j, Arr<EntityPair>& out_pairs, unsigned& filtered) const;
+
+    // previous body list, for change detection
+    Arr<Entity*> prevBodies;
+};
+
+// --------------------------------------------------------------------------
+// incremental sort and sweep along the x axis
+// the sorted list is kept between steps, so a coherent scene costs a nearly linear insertion sort
+struct SweepAndPrune : public Broadphase
+{
+    // body index sorted on min.x of its box
+    Arr<unsigned> axisX;
+
+    SweepAndPrune();
+    virtual ~SweepAndPrune();
+
+    virtual void update(const Arr<Entity*>& entities);
+    virtual void findPairs(Arr<EntityPair>& out_pairs);
+};
+
+// --------------------------------------------------------------------------
+// uniform grid stored as a spatial hash
+// suited to dense scenes of similar sized bodies (cell size close to the body size)
+// buffers are kept between steps, so a steady state step does not allocate
+struct GridBroadphase : public Broadphase
+{
+    // a body registered in one cell
+    struct Entry
+    {
+        int cx;
+        int cy;
+        unsigned body;
+    };
+
+    // width of a square cell
+    float cellSize;
+
+    // entries in filling order, then grouped by hash bucket
+    Arr<Entry> entries;
+    Arr<Entry> buckets;
+
+    // first entry of each bucket in 'buckets' (bucketCount+1 values)
+    Arr<unsigned> bucketStart;
+    unsigned bucketCount;
+
+    // cs : cell size
+    GridBroadphase(float cs = 32.f);
+    virtual ~GridBroadphase();
+
+    virtual void update(const Arr<Entity*>& entities);
+    virtual void findPairs(Arr<EntityPair>& out_pairs);
+
+    // bucket index of the cell (cx,cy)
+    unsigned hashCell(int cx, int cy) const;
+
+    // cell coordinate of a world position
+    int cellCoord(float v) const;
+};
+
+// --------------------------------------------------------------------------
+// dynamic bounding volume tree with fattened leaves
+// suited to scenes mixing big and small bodies ; most steps only check the fat boxes
+struct TreeBroadphase : public Broadphase
+{
+    AABBTree tree;
+
+    // tree leaf of each body
+    Arr<int> leaves;
+
+    // overlapping leaves found by the tree (body indices)
+    Arr< std::pair<unsigned,unsigned> > treePairs;
+
+    // margin : fattening distance of the leaves
+    TreeBroadphase(float margin = 4.f);
+    virtual ~TreeBroadphase();
+
+    virtual void update(const Arr<Entity*>& entities);
+    virtual void findPairs(Arr<EntityPair>& out_pairs);
+    virtual void reserve(unsigned pairCount);
+
+    // append the bodies whose bounds overlap box (valid after update)
+    void query(const AABB& box, Arr<Entity*>& out_bodies);
+
+protected:
+    Arr<unsigned> queryRes;
+};
+
+// --------------------------------------------------------------------------
+// linear bounding volume hierarchy rebuilt from scratch at each update
+// bodies are sorted on the morton code of their box center (parallel radix sort),
+// then every internal node is emitted independently (Karras 2012)
+// suited to very big worlds where maintaining a tree costs more than rebuilding it
+struct LinearBVHBroadphase : public Broadphase
+{
+    // items processed per parallel chunk
+    static const unsigned GRAIN = 1024;
+
+    // internal nodes are [0;n-1), leaves are [n-1;2n-1) in sorted order
+    struct Node
+    {
+        AABB box;
+        int parent;
+        int child1;
+        int child2;
+
+        // last leaf (sorted order) of the subtree
+        unsigned rangeEnd;
+    };
+
+    ThreadPool* pool;
+    bool ownPool;
+
+    // morton codes and body indices, in sorted order after update
+    Arr<unsigned> codes;
+    Arr<unsigned> order;
+
+    Arr<Node> nodes;
+
+    // pool : shared threads (not owned), the build runs on the calling thread only if null
+    LinearBVHBroadphase(ThreadPool* pool = nullptr);
+    virtual ~LinearBVHBroadphase();
+
+    virtual void update(const Arr<Entity*>& entities);
+    virtual void findPairs(Arr<EntityPair>& out_pairs);
+
+protected:
+    // sort codes and order by code (stable)
+    void radixSort();
+
+    // build node i of the hierarchy
+    void buildNode(int i);
+
+    // common prefix length of the sorted codes i and j (-1 if j is out of range)
+    int delta(int i, int j) const;
+
+    // radix sort buffers
+    Arr<unsigned> tmpCodes;
+    Arr<unsigned> tmpOrder;
+    Arr<unsigned> histograms;
+
+    // bottom-up fitting : the second child reaching a node computes its box
+    Arr< std::atomic<int> > visits;
+
+    // pairs found and filtered by each traversal chunk
+    Arr< Arr<EntityPair> > chunkPairs;
+    Arr<unsigned> chunkFiltered;
+};
+
+// --------------------------------------------------------------------------
+// bodies which never move (mass == 0)
+// indexed once when registered, then only queried by the dynamic bodies
+struct StaticGeometry
+{
+    Arr<Entity*> bodies;
+    Arr<AABB> boxes;
+    AABBTree tree;
+
+    // pairs rejected by collision filtering during the last findPairs
+    unsigned filteredPairs;
+
+    StaticGeometry();
+    virtual ~StaticGeometry();
+
+    // register a static entity (group children are expanded)
+    void add(Entity* e);
+
+    // remove all static bodies
+    void clear();
+
+    // append the index of each static body whose bounds overlap box
+    void query(const AABB& box, Arr<unsigned>& out_bodies) const;
+    
+    // index of a static body in bodies (~0u if not found)
+    unsigned indexOf(const Entity* e) const;
+
+    // append the pairs between the given dynamic bodies and the static ones
+    void findPairs(const Arr<Entity*>& dynBodies, const Arr<AABB>& dynBoxes, Arr<EntityPair>& out_pairs);
+
+protected:
+    Arr<unsigned> hits;
+    
+    // (body, index) sorted by body, for indexOf
+    Arr< std::pair<const Entity*,unsigned> > lookup;
+};
+
+// --------------------------------------------------------------------------
+// expand an entity into its collidable bodies (group children)
+void expandBodies(Entity* e, Arr<Entity*>& out_bodies);
+
+// --------------------------------------------------------------------------
+// test if 2 bodies are allowed to collide (static pairs and group siblings are skipped)
+bool acceptPair(const Entity& e1, const Entity& e2);
+
+// --------------------------------------------------------------------------
+// filter a pair
+// filtered is incremented when the pair is rejected by collision filtering
+bool makePair(Entity* e1, Entity* e2, EntityPair& out_pair, unsigned& filtered);
+
+
+#endif // PHYSIC_BROADPHASE_HPP
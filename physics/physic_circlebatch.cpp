@@ -0,0 +1,238 @@
+#include "physic_circlebatch.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define PHYSIC_X86
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+#endif
+
+#if defined(__GNUC__)
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define TARGET_AVX2
+#endif
+
+// the vector test keeps pairs up to this factor of the squared radius sum,
+// so float rounding can never reject a pair accepted by the exact test
+#define BATCH_MARGIN 1.0001f
+
+// --------------------------------------------------------------------------
+CircleBatch::CircleBatch() {}
+
+// --------------------------------------------------------------------------
+CircleBatch::~CircleBatch() {}
+
+// --------------------------------------------------------------------------
+unsigned CircleBatch::size() const
+{
+    return circles.size();
+}
+
+// --------------------------------------------------------------------------
+void CircleBatch::clear()
+{
+    x.clear();
+    y.clear();
+    radius.clear();
+    circles.clear();
+    tags.clear();
+    flipped.clear();
+}
+
+// --------------------------------------------------------------------------
+void CircleBatch::reserve(unsigned n)
+{
+    x.reserve(n);
+    y.reserve(n);
+    radius.reserve(n);
+    circles.reserve(n);
+    tags.reserve(n);
+    flipped.reserve(n);
+}
+
+// --------------------------------------------------------------------------
+void CircleBatch::add(CircleEntity* c, unsigned tag, bool flip)
+{
+    const Vec2& p = c->position();
+    x.push_back(p.x);
+    y.push_back(p.y);
+    radius.push_back(c->radius);
+    circles.push_back(c);
+    tags.push_back(tag);
+    flipped.push_back(flip ? 1 : 0);
+}
+
+
+
+// --------------------------------------------------------------------------
+// exact test of the candidate i, which passed the squared distance test
+inline unsigned collideCandidate(const CircleEntity& c, const CircleBatch& batch, unsigned i, Arr<CollisionData>& out, Arr<unsigned>& tags, unsigned& tests)
+{
+    const CircleEntity& other = *batch.circles[i];
+    if(c.mass() == 0.f && other.mass() == 0.f) return 0;
+    tests++;
+
+    CollisionData res;
+    bool hit = batch.flipped[i] ? Circle2Circle(other, c, res) : Circle2Circle(c, other, res);
+    if(!hit) return 0;
+    out.push_back(res);
+    tags.push_back(batch.tags[i]);
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+unsigned batchScalar(const CircleEntity& c, const CircleBatch& batch, unsigned begin, Arr<CollisionData>& out, Arr<unsigned>& tags, unsigned& tests)
+{
+    const Vec2& p = c.position();
+    unsigned hits = 0;
+    for(unsigned i=begin; i<batch.size(); ++i)
+    {
+        float dx = batch.x[i] - p.x;
+        float dy = batch.y[i] - p.y;
+        float th = batch.radius[i] + c.radius;
+        if(dx*dx + dy*dy <= th*th*BATCH_MARGIN) hits += collideCandidate(c, batch, i, out, tags, tests);
+    }
+    return hits;
+}
+
+
+
+#if defined(PHYSIC_X86)
+
+// --------------------------------------------------------------------------
+// index of the lowest set bit (mask != 0)
+inline int lowestBit(int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long k;
+    _BitScanForward(&k, mask);
+    return (int)k;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// --------------------------------------------------------------------------
+// 4 candidates per iteration
+unsigned batchSSE2(const CircleEntity& c, const CircleBatch& batch, Arr<CollisionData>& out, Arr<unsigned>& tags, unsigned& tests)
+{
+    const Vec2& p = c.position();
+    __m128 px = _mm_set1_ps(p.x);
+    __m128 py = _mm_set1_ps(p.y);
+    __m128 pr = _mm_set1_ps(c.radius);
+    __m128 margin = _mm_set1_ps(BATCH_MARGIN);
+
+    unsigned n = batch.size();
+    unsigned hits = 0;
+    unsigned i = 0;
+    for(; i+4<=n; i+=4)
+    {
+        __m128 dx = _mm_sub_ps( _mm_loadu_ps(&batch.x[i]), px );
+        __m128 dy = _mm_sub_ps( _mm_loadu_ps(&batch.y[i]), py );
+        __m128 th = _mm_add_ps( _mm_loadu_ps(&batch.radius[i]), pr );
+        __m128 d2 = _mm_add_ps( _mm_mul_ps(dx,dx), _mm_mul_ps(dy,dy) );
+        int mask = _mm_movemask_ps( _mm_cmple_ps(d2, _mm_mul_ps(_mm_mul_ps(th,th),margin)) );
+
+        while(mask)
+        {
+            int k = lowestBit(mask);
+            mask &= mask-1;
+            hits += collideCandidate(c, batch, i+k, out, tags, tests);
+        }
+    }
+    if(i == n) return hits;
+    
+    // tail : the last candidates copied in a padded vector, the empty lanes masked out
+    float tx[4] = {}, ty[4] = {}, tr[4] = {};
+    for(unsigned k=0; i+k<n; ++k)
+    {
+        tx[k] = batch.x[i+k];
+        ty[k] = batch.y[i+k];
+        tr[k] = batch.radius[i+k];
+    }
+    __m128 dx = _mm_sub_ps( _mm_loadu_ps(tx), px );
+    __m128 dy = _mm_sub_ps( _mm_loadu_ps(ty), py );
+    __m128 th = _mm_add_ps( _mm_loadu_ps(tr), pr );
+    __m128 d2 = _mm_add_ps( _mm_mul_ps(dx,dx), _mm_mul_ps(dy,dy) );
+    int mask = _mm_movemask_ps( _mm_cmple_ps(d2, _mm_mul_ps(_mm_mul_ps(th,th),margin)) ) & ((1 << (n-i)) - 1);
+    while(mask)
+    {
+        int k = lowestBit(mask);
+        mask &= mask-1;
+        hits += collideCandidate(c, batch, i+k, out, tags, tests);
+    }
+    return hits;
+}
+
+// --------------------------------------------------------------------------
+// 8 candidates per iteration
+TARGET_AVX2 unsigned batchAVX2(const CircleEntity& c, const CircleBatch& batch, Arr<CollisionData>& out, Arr<unsigned>& tags, unsigned& tests)
+{
+    const Vec2& p = c.position();
+    __m256 px = _mm256_set1_ps(p.x);
+    __m256 py = _mm256_set1_ps(p.y);
+    __m256 pr = _mm256_set1_ps(c.radius);
+    __m256 margin = _mm256_set1_ps(BATCH_MARGIN);
+
+    unsigned n = batch.size();
+    unsigned hits = 0;
+    unsigned i = 0;
+    for(; i+8<=n; i+=8)
+    {
+        __m256 dx = _mm256_sub_ps( _mm256_loadu_ps(&batch.x[i]), px );
+        __m256 dy = _mm256_sub_ps( _mm256_loadu_ps(&batch.y[i]), py );
+        __m256 th = _mm256_add_ps( _mm256_loadu_ps(&batch.radius[i]), pr );
+        __m256 d2 = _mm256_add_ps( _mm256_mul_ps(dx,dx), _mm256_mul_ps(dy,dy) );
+        int mask = _mm256_movemask_ps( _mm256_cmp_ps(d2, _mm256_mul_ps(_mm256_mul_ps(th,th),margin), _CMP_LE_OQ) );
+
+        while(mask)
+        {
+            int k = lowestBit(mask);
+            mask &= mask-1;
+            hits += collideCandidate(c, batch, i+k, out, tags, tests);
+        }
+    }
+    if(i == n) return hits;
+    
+    // tail : only the lanes of the last candidates are loaded
+    int rest = (int)(n-i);
+    __m256i lanes = _mm256_cmpgt_epi32( _mm256_set1_epi32(rest), _mm256_setr_epi32(0,1,2,3,4,5,6,7) );
+    __m256 dx = _mm256_sub_ps( _mm256_maskload_ps(&batch.x[i], lanes), px );
+    __m256 dy = _mm256_sub_ps( _mm256_maskload_ps(&batch.y[i], lanes), py );
+    __m256 th = _mm256_add_ps( _mm256_maskload_ps(&batch.radius[i], lanes), pr );
+    __m256 d2 = _mm256_add_ps( _mm256_mul_ps(dx,dx), _mm256_mul_ps(dy,dy) );
+    int mask = _mm256_movemask_ps( _mm256_cmp_ps(d2, _mm256_mul_ps(_mm256_mul_ps(th,th),margin), _CMP_LE_OQ) ) & ((1 << rest) - 1);
+    while(mask)
+    {
+        int k = lowestBit(mask);
+        mask &= mask-1;
+        hits += collideCandidate(c, batch, i+k, out, tags, tests);
+    }
+    return hits;
+}
+
+#endif // PHYSIC_X86
+
+
+
+// --------------------------------------------------------------------------
+unsigned collideCircleBatch(const CircleEntity& c, const CircleBatch& batch, Arr<CollisionData>& out, Arr<unsigned>& out_tags, unsigned& out_tests, SimdLevel level)
+{
+#if defined(PHYSIC_X86)
+    if(level == SIMD_AVX2) return batchAVX2(c, batch, out, out_tags, out_tests);
+    if(level == SIMD_SSE2) return batchSSE2(c, batch, out, out_tags, out_tests);
+#endif
+    return batchScalar(c, batch, 0, out, out_tags, out_tests);
+}
+
+// --------------------------------------------------------------------------
+unsigned circleBatchWidth(SimdLevel level)
+{
+#if defined(PHYSIC_X86)
+    if(level == SIMD_AVX2) return 8;
+    if(level == SIMD_SSE2) return 4;
+#endif
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef PHYSIC_CIRCLEBATCH_HPP
+#define PHYSIC_CIRCLEBATCH_HPP
+
+#include "physic_entity.hpp"
+#include "physic_integrate.hpp"
+
+
+// --------------------------------------------------------------------------
+// packed block of candidate circles tested against a single circle
+// positions and radii are copied in separate arrays for vector loads
+struct CircleBatch
+{
+    Arr<float> x;
+    Arr<float> y;
+    Arr<float> radius;
+    Arr<CircleEntity*> circles;
+    
+    // per candidate : value given back with its collision, and exact test run as (candidate, circle)
+    Arr<unsigned> tags;
+    Arr<unsigned char> flipped;
+
+    CircleBatch();
+    virtual ~CircleBatch();
+
+    // number of candidates
+    unsigned size() const;
+
+    // remove all candidates (capacity is kept)
+    void clear();
+    
+    // capacity for n candidates
+    void reserve(unsigned n);
+
+    // add a candidate circle
+    // tag : appended to the tags of the collisions with c
+    // flip : the collision is (c, tested circle) instead of (tested circle, c)
+    void add(CircleEntity* c, unsigned tag = 0, bool flip = false);
+};
+
+// --------------------------------------------------------------------------
+// test c against every candidate of the batch, append a collision (c,candidate) per hit
+// ((candidate,c) for a flipped candidate) and the tag of the candidate to out_tags
+// squared distances are compared with vector instructions (a partial last vector is masked), only the (few) hits
+// go through the exact Circle2Circle test, so results are identical to calling it per pair
+// out_tests is increased by the number of exact tests run
+// return the number of collisions appended
+unsigned collideCircleBatch(const CircleEntity& c, const CircleBatch& batch, Arr<CollisionData>& out, Arr<unsigned>& out_tags, unsigned& out_tests, SimdLevel level);
+
+// --------------------------------------------------------------------------
+// candidates per vector test of a level (0 for the scalar level : no gain over a pair by pair test)
+// a batch may hold any number of candidates, the lanes past the last one are masked out
+unsigned circleBatchWidth(SimdLevel level);
+
+
+#endif // PHYSIC_CIRCLEBATCH_HPP
@@ -0,0 +1,698 @@
+#include "physic_colorsolver.hpp"
+#include "physic_island.hpp"
+#include "physic_response.hpp"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define PHYSIC_X86
+    #include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define TARGET_AVX2
+#endif
+
+#define NO_NODE (~0u)
+
+// --------------------------------------------------------------------------
+ContactColoring::ContactColoring()
+    : overflow(false)
+{}
+
+// --------------------------------------------------------------------------
+ContactColoring::~ContactColoring() {}
+
+// --------------------------------------------------------------------------
+unsigned ContactColoring::size() const
+{
+    return start.empty() ? 0 : start.size() - 1;
+}
+
+// --------------------------------------------------------------------------
+unsigned ContactColoring::count(unsigned k) const
+{
+    return start[k+1] - start[k];
+}
+
+// --------------------------------------------------------------------------
+void ContactColoring::build(const Arr<CollisionData>& collisions, const BodyStore& bodies)
+{
+    contacts.clear();
+    start.clear();
+    contactColor.clear();
+    overflow = false;
+
+    if(used.size() < bodies.size()) used.resize(bodies.size(), 0);
+
+    // lowest color free for both bodies of each contact
+    Arr<unsigned>& counts = start;
+    for(auto& coll : collisions)
+    {
+        unsigned s[2] = { solverSlot(coll.e1,bodies), solverSlot(coll.e2,bodies) };
+        unsigned long long taken = 0;
+        for(auto slot : s) if(slot != NO_NODE) taken |= used[slot];
+
+        unsigned color = 0;
+        while(color < MAX_COLORS && (taken & (1ull << color))) color++;
+
+        if(color < MAX_COLORS)
+        {
+            for(auto slot : s)
+            {
+                if(slot == NO_NODE) continue;
+                if(used[slot] == 0) touched.push_back(slot);
+                used[slot] |= 1ull << color;
+            }
+        }
+        else overflow = true;
+
+        // a color is given only if the lower ones are taken, so colors stay contiguous
+        // (the overflow color comes after the MAX_COLORS full ones)
+        if(counts.size() <= color) counts.resize(color+1, 0);
+        counts[color]++;
+        contactColor.push_back(color);
+    }
+
+    // counts to offsets, then contacts placed in their order
+    unsigned colorCount = counts.size();
+    unsigned offset = 0;
+    for(unsigned k=0; k<colorCount; ++k)
+    {
+        unsigned c = counts[k];
+        counts[k] = offset;
+        offset += c;
+    }
+    counts.push_back(offset);
+
+    contacts.resize(collisions.size());
+    for(unsigned i=0; i<collisions.size(); ++i) contacts[ start[contactColor[i]]++ ] = i;
+
+    for(unsigned k=colorCount; k>0; --k) start[k] = start[k-1];
+    start[0] = 0;
+
+    for(auto slot : touched) used[slot] = 0;
+    touched.clear();
+}
+
+// --------------------------------------------------------------------------
+void ContactColoring::reserve(unsigned bodyCount, unsigned contactCount)
+{
+    if(used.size() < bodyCount) used.resize(bodyCount, 0);
+    touched.reserve(bodyCount);
+    contacts.reserve(contactCount);
+    contactColor.reserve(contactCount);
+    start.reserve(MAX_COLORS+2);
+}
+
+
+
+// --------------------------------------------------------------------------
+void BodyLanes::resize(unsigned n)
+{
+    px.resize(n); py.resize(n);
+    vx.resize(n); vy.resize(n);
+    w.resize(n);
+    m.resize(n);
+    restitution.resize(n);
+}
+
+// --------------------------------------------------------------------------
+ContactLanes::ContactLanes()
+    : size(0)
+{}
+
+// --------------------------------------------------------------------------
+void ContactLanes::resize(unsigned n)
+{
+    size = n;
+    hx.resize(n); hy.resize(n);
+    n1x.resize(n); n1y.resize(n);
+    n2x.resize(n); n2y.resize(n);
+    correction.resize(n);
+    i1.resize(n); i2.resize(n);
+    a.resize(n);
+    b.resize(n);
+    fx.resize(n); fy.resize(n);
+    tx.resize(n); ty.resize(n);
+    dist.resize(n);
+    ix.resize(n); iy.resize(n);
+    angle.resize(n);
+    active.resize(n);
+}
+
+// --------------------------------------------------------------------------
+void ContactLanes::reserve(unsigned n)
+{
+    // arrays keep their capacity when shrunk
+    unsigned count = size;
+    if(n > count) resize(n);
+    resize(count);
+}
+
+// --------------------------------------------------------------------------
+void gatherBody(BodyLanes& lanes, unsigned k, const Entity& e)
+{
+    const Vec2& p = e.position();
+    const Vec2& v = e.v_linear();
+    lanes.px[k] = p.x; lanes.py[k] = p.y;
+    lanes.vx[k] = v.x; lanes.vy[k] = v.y;
+    lanes.w[k] = e.v_angular();
+    lanes.m[k] = e.mass();
+    lanes.restitution[k] = e.restitution();
+}
+
+// --------------------------------------------------------------------------
+// only moved bodies are written : static ones may be read by other threads
+void scatterBody(const BodyLanes& lanes, unsigned k, Entity& e)
+{
+    if(lanes.m[k] == 0.f) return;
+    e.position() = Vec2(lanes.px[k], lanes.py[k]);
+    e.v_linear() = Vec2(lanes.vx[k], lanes.vy[k]);
+    e.v_angular() = lanes.w[k];
+}
+
+
+
+// --------------------------------------------------------------------------
+// the stages below process the lanes [begin;size), the vector versions the whole vectors
+// from 0 and return where they stopped
+// the scalar versions run the stages of physic_response.hpp, as the engine does
+
+// --------------------------------------------------------------------------
+// resolvePenetration
+void penetrationScalar(ContactLanes& L, unsigned begin)
+{
+    BodyLanes& A = L.a;
+    BodyLanes& B = L.b;
+    for(unsigned i=begin; i<L.size; ++i)
+    {
+        Vec2 pa(A.px[i], A.py[i]), pb(B.px[i], B.py[i]);
+        separateBodies(A.m[i], B.m[i], L.correction[i], Vec2(L.n1x[i], L.n1y[i]), Vec2(L.n2x[i], L.n2y[i]), pa, pb);
+        A.px[i] = pa.x; A.py[i] = pa.y;
+        B.px[i] = pb.x; B.py[i] = pb.y;
+    }
+}
+
+// --------------------------------------------------------------------------
+// applyImpulse of (ix,iy) on S up to the angle : linear velocity and tangent impulse / distance
+void impulseScalar(ContactLanes& L, BodyLanes& S, const float* ix, const float* iy, unsigned begin)
+{
+    for(unsigned i=begin; i<L.size; ++i)
+    {
+        bool on = S.m[i] != 0.f;
+        L.active[i] = on ? 1.f : 0.f;
+        if(!on) continue;
+
+        Vec2 v(S.vx[i], S.vy[i]);
+        L.angle[i] = impulseLinear(Vec2(L.hx[i], L.hy[i]), Vec2(S.px[i], S.py[i]), Vec2(ix[i], iy[i]), v);
+        S.vx[i] = v.x; S.vy[i] = v.y;
+    }
+}
+
+// --------------------------------------------------------------------------
+// end of applyImpulse, once angle holds the angular impulse
+void angularScalar(ContactLanes& L, BodyLanes& S, unsigned begin)
+{
+    for(unsigned i=begin; i<L.size; ++i)
+    {
+        if(L.active[i] != 0.f) impulseAngular(L.angle[i], S.w[i]);
+    }
+}
+
+// --------------------------------------------------------------------------
+// applyResponse up to the tangent velocity : tangent, distance, and angle for std::tan
+void responseBeginScalar(ContactLanes& L, BodyLanes& S, unsigned begin)
+{
+    for(unsigned i=begin; i<L.size; ++i)
+    {
+        Vec2 tan;
+        responseTangent(Vec2(L.hx[i], L.hy[i]), Vec2(S.px[i], S.py[i]), tan, L.dist[i]);
+        L.tx[i] = tan.x; L.ty[i] = tan.y;
+        L.angle[i] = responseAngle(S.w[i]);
+    }
+}
+
+// --------------------------------------------------------------------------
+// end of applyResponse : impulse of S against O along the normal n, correcting the normal
+// impulse acc, kept in (ix,iy) for the impulse stage
+void responseEndScalar(ContactLanes& L, BodyLanes& S, const BodyLanes& O, const float* nx, const float* ny, float* acc, unsigned begin)
+{
+    for(unsigned i=begin; i<L.size; ++i)
+    {
+        Vec2 impulseVec;
+        if(S.m[i] != 0.f)
+        {
+            impulseVec = responseImpulse(Vec2(L.tx[i], L.ty[i]), L.angle[i], L.dist[i], Vec2(S.vx[i], S.vy[i]),
+                                         Vec2(nx[i], ny[i]), S.m[i], O.m[i], S.restitution[i], acc[i]);
+        }
+        L.ix[i] = impulseVec.x;
+        L.iy[i] = impulseVec.y;
+    }
+}
+
+// --------------------------------------------------------------------------
+// warm start of S : its normal impulse acc pushes it along the normal n
+// (one multiply and add per component, the same operations at every level)
+void warmLanes(ContactLanes& L, BodyLanes& S, const float* nx, const float* ny, const float* acc)
+{
+    for(unsigned i=0; i<L.size; ++i)
+    {
+        if(S.m[i] == 0.f) continue;
+        S.vx[i] += nx[i] * acc[i];
+        S.vy[i] += ny[i] * acc[i];
+    }
+}
+
+// --------------------------------------------------------------------------
+// std functions per lane, as in the scalar code
+void tanLanes(ContactLanes& L)
+{
+    for(unsigned i=0; i<L.size; ++i) L.angle[i] = std::tan(L.angle[i]);
+}
+
+// --------------------------------------------------------------------------
+void atanLanes(ContactLanes& L)
+{
+    for(unsigned i=0; i<L.size; ++i) L.angle[i] = impulseAngle(L.angle[i]);
+}
+
+
+
+#if defined(PHYSIC_X86)
+
+// --------------------------------------------------------------------------
+// 4 lanes helpers
+inline __m128 ld4(const float* p) { return _mm_loadu_ps(p); }
+inline void st4(float* p, __m128 v) { _mm_storeu_ps(p, v); }
+inline __m128 set4(float f) { return _mm_set1_ps(f); }
+inline __m128 add4(__m128 a, __m128 b) { return _mm_add_ps(a,b); }
+inline __m128 sub4(__m128 a, __m128 b) { return _mm_sub_ps(a,b); }
+inline __m128 mul4(__m128 a, __m128 b) { return _mm_mul_ps(a,b); }
+inline __m128 div4(__m128 a, __m128 b) { return _mm_div_ps(a,b); }
+inline __m128 sqrt4(__m128 a) { return _mm_sqrt_ps(a); }
+inline __m128 and4(__m128 a, __m128 b) { return _mm_and_ps(a,b); }
+inline __m128 neg4(__m128 a) { return _mm_xor_ps(a, _mm_set1_ps(-0.f)); }
+inline __m128 neq4(__m128 a, __m128 b) { return _mm_cmpneq_ps(a,b); }
+inline __m128 gt4(__m128 a, __m128 b) { return _mm_cmpgt_ps(a,b); }
+
+// std::max(a,b) : a < b ? b : a
+inline __m128 max4(__m128 a, __m128 b) { return _mm_max_ps(b,a); }
+
+// select b where mask is set, else a
+inline __m128 select4(__m128 a, __m128 b, __m128 mask)
+{
+    return _mm_or_ps( _mm_and_ps(mask,b), _mm_andnot_ps(mask,a) );
+}
+
+// r * (x,y), as Transform::transformPoint
+inline void rotate4(const Transform& r, __m128 x, __m128 y, __m128& out_x, __m128& out_y)
+{
+    out_x = add4( add4( mul4(set4(r.m[0]),x), mul4(set4(r.m[1]),y) ), set4(r.m[2]) );
+    out_y = add4( add4( mul4(set4(r.m[3]),x), mul4(set4(r.m[4]),y) ), set4(r.m[5]) );
+}
+
+// --------------------------------------------------------------------------
+unsigned penetrationSSE2(ContactLanes& L)
+{
+    BodyLanes& A = L.a;
+    BodyLanes& B = L.b;
+    __m128 zero = set4(0.f);
+    unsigned i = 0;
+    for(; i+4<=L.size; i+=4)
+    {
+        __m128 ma = ld4(&A.m[i]);
+        __m128 mb = ld4(&B.m[i]);
+        __m128 massTT = add4(ma,mb);
+        __m128 moving = neq4(massTT,zero);
+        __m128 ratio1 = div4(ma,massTT);
+        __m128 ratio2 = div4(mb,massTT);
+        __m128 maskA = and4(moving, neq4(ratio1,zero));
+        __m128 maskB = and4(moving, neq4(ratio2,zero));
+        __m128 c = ld4(&L.correction[i]);
+
+        __m128 pax = ld4(&A.px[i]), pay = ld4(&A.py[i]);
+        st4(&A.px[i], select4(pax, add4(pax, mul4(mul4(ld4(&L.n2x[i]),c),ratio1)), maskA));
+        st4(&A.py[i], select4(pay, add4(pay, mul4(mul4(ld4(&L.n2y[i]),c),ratio1)), maskA));
+
+        __m128 pbx = ld4(&B.px[i]), pby = ld4(&B.py[i]);
+        st4(&B.px[i], select4(pbx, add4(pbx, mul4(mul4(ld4(&L.n1x[i]),c),ratio2)), maskB));
+        st4(&B.py[i], select4(pby, add4(pby, mul4(mul4(ld4(&L.n1y[i]),c),ratio2)), maskB));
+    }
+    return i;
+}
+
+// --------------------------------------------------------------------------
+unsigned impulseSSE2(ContactLanes& L, BodyLanes& S, const float* ix, const float* iy)
+{
+    const Transform& r = responseRot90();
+    __m128 zero = set4(0.f);
+    unsigned i = 0;
+    for(; i+4<=L.size; i+=4)
+    {
+        __m128 jx = ld4(ix+i), jy = ld4(iy+i);
+        __m128 on = neq4(ld4(&S.m[i]),zero);
+        st4(&L.active[i], on);
+
+        __m128 dx = sub4(ld4(&L.hx[i]), ld4(&S.px[i]));
+        __m128 dy = sub4(ld4(&L.hy[i]), ld4(&S.py[i]));
+        __m128 dist = sqrt4(add4(mul4(dx,dx),mul4(dy,dy)));
+        __m128 fx = div4(dx,dist), fy = div4(dy,dist);
+        __m128 tx, ty;
+        rotate4(r, fx, fy, tx, ty);
+
+        __m128 d = add4(mul4(fx,jx),mul4(fy,jy));
+        __m128 vx = ld4(&S.vx[i]), vy = ld4(&S.vy[i]);
+        st4(&S.vx[i], select4(vx, add4(vx,mul4(fx,d)), on));
+        st4(&S.vy[i], select4(vy, add4(vy,mul4(fy,d)), on));
+        st4(&L.angle[i], div4(add4(mul4(jx,tx),mul4(jy,ty)), dist));
+    }
+    return i;
+}
+
+// --------------------------------------------------------------------------
+unsigned angularSSE2(ContactLanes& L, BodyLanes& S)
+{
+    unsigned i = 0;
+    for(; i+4<=L.size; i+=4)
+    {
+        __m128 w = ld4(&S.w[i]);
+        __m128 angularImpulse = sub4(ld4(&L.angle[i]), w);
+        st4(&S.w[i], select4(w, add4(w,angularImpulse), ld4(&L.active[i])));
+    }
+    return i;
+}
+
+// --------------------------------------------------------------------------
+unsigned responseBeginSSE2(ContactLanes& L, BodyLanes& S)
+{
+    const Transform& r = responseRot90();
+    unsigned i = 0;
+    for(; i+4<=L.size; i+=4)
+    {
+        __m128 dx = sub4(ld4(&L.hx[i]), ld4(&S.px[i]));
+        __m128 dy = sub4(ld4(&L.hy[i]), ld4(&S.py[i]));
+        __m128 dist = sqrt4(add4(mul4(dx,dx),mul4(dy,dy)));
+        __m128 tx, ty;
+        rotate4(r, div4(dx,dist), div4(dy,dist), tx, ty);
+        st4(&L.tx[i], tx);
+        st4(&L.ty[i], ty);
+        st4(&L.dist[i], dist);
+        st4(&L.angle[i], div4(mul4(ld4(&S.w[i]),set4(3.1415f)),set4(180.f)));
+    }
+    return i;
+}
+
+// --------------------------------------------------------------------------
+unsigned responseEndSSE2(ContactLanes& L, BodyLanes& S, const BodyLanes& O, const float* nx, const float* ny, float* acc)
+{
+    const Transform& r = responseRot90();
+    __m128 zero = set4(0.f);
+    unsigned i = 0;
+    for(; i+4<=L.size; i+=4)
+    {
+        __m128 ms = ld4(&S.m[i]), mo = ld4(&O.m[i]);
+        __m128 nx4 = ld4(nx+i), ny4 = ld4(ny+i);
+        __m128 sx, sy;
+        rotate4(r, neg4(nx4), neg4(ny4), sx, sy);
+
+        __m128 tv = ld4(&L.angle[i]), dist = ld4(&L.dist[i]);
+        __m128 vcx = add4(ld4(&S.vx[i]), mul4(mul4(ld4(&L.tx[i]),tv),dist));
+        __m128 vcy = add4(ld4(&S.vy[i]), mul4(mul4(ld4(&L.ty[i]),tv),dist));
+
+        __m128 approach = neg4(add4(mul4(nx4,vcx),mul4(ny4,vcy)));
+        __m128 slow = add4(mul4(sx,vcx),mul4(sy,vcy));
+        __m128 response = select4(set4(1.f), div4(ms,add4(ms,mo)), neq4(mo,zero));
+
+        __m128 acc0 = ld4(acc+i);
+        __m128 rate = select4(set4(1.f), response, gt4(approach,zero));
+        __m128 accumulated = max4(add4(acc0,mul4(approach,rate)), zero);
+        __m128 correction = sub4(accumulated, acc0);
+        __m128 bounce = mul4(max4(approach,zero), ld4(&S.restitution[i]));
+        __m128 k = add4(correction, bounce);
+
+        __m128 friction = set4(CONTACT_FRICTION);
+        __m128 on = neq4(ms,zero);
+        __m128 jx = and4(on, sub4(mul4(nx4,k), mul4(mul4(sx,slow),friction)));
+        __m128 jy = and4(on, sub4(mul4(ny4,k), mul4(mul4(sy,slow),friction)));
+
+        st4(acc+i, select4(acc0, accumulated, on));
+        st4(&L.ix[i], jx);
+        st4(&L.iy[i], jy);
+    }
+    return i;
+}
+
+
+
+// --------------------------------------------------------------------------
+// 8 lanes versions of the helpers above
+TARGET_AVX2 inline __m256 ld8(const float* p) { return _mm256_loadu_ps(p); }
+TARGET_AVX2 inline void st8(float* p, __m256 v) { _mm256_storeu_ps(p, v); }
+TARGET_AVX2 inline __m256 set8(float f) { return _mm256_set1_ps(f); }
+TARGET_AVX2 inline __m256 add8(__m256 a, __m256 b) { return _mm256_add_ps(a,b); }
+TARGET_AVX2 inline __m256 sub8(__m256 a, __m256 b) { return _mm256_sub_ps(a,b); }
+TARGET_AVX2 inline __m256 mul8(__m256 a, __m256 b) { return _mm256_mul_ps(a,b); }
+TARGET_AVX2 inline __m256 div8(__m256 a, __m256 b) { return _mm256_div_ps(a,b); }
+TARGET_AVX2 inline __m256 sqrt8(__m256 a) { return _mm256_sqrt_ps(a); }
+TARGET_AVX2 inline __m256 and8(__m256 a, __m256 b) { return _mm256_and_ps(a,b); }
+TARGET_AVX2 inline __m256 neg8(__m256 a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.f)); }
+TARGET_AVX2 inline __m256 neq8(__m256 a, __m256 b) { return _mm256_cmp_ps(a,b,_CMP_NEQ_UQ); }
+TARGET_AVX2 inline __m256 gt8(__m256 a, __m256 b) { return _mm256_cmp_ps(a,b,_CMP_GT_OQ); }
+TARGET_AVX2 inline __m256 max8(__m256 a, __m256 b) { return _mm256_max_ps(b,a); }
+TARGET_AVX2 inline __m256 select8(__m256 a, __m256 b, __m256 mask)
+{
+    return _mm256_blendv_ps(a,b,mask);
+}
+TARGET_AVX2 inline void rotate8(const Transform& r, __m256 x, __m256 y, __m256& out_x, __m256& out_y)
+{
+    out_x = add8( add8( mul8(set8(r.m[0]),x), mul8(set8(r.m[1]),y) ), set8(r.m[2]) );
+    out_y = add8( add8( mul8(set8(r.m[3]),x), mul8(set8(r.m[4]),y) ), set8(r.m[5]) );
+}
+
+// --------------------------------------------------------------------------
+TARGET_AVX2 unsigned penetrationAVX2(ContactLanes& L)
+{
+    BodyLanes& A = L.a;
+    BodyLanes& B = L.b;
+    __m256 zero = set8(0.f);
+    unsigned i = 0;
+    for(; i+8<=L.size; i+=8)
+    {
+        __m256 ma = ld8(&A.m[i]);
+        __m256 mb = ld8(&B.m[i]);
+        __m256 massTT = add8(ma,mb);
+        __m256 moving = neq8(massTT,zero);
+        __m256 ratio1 = div8(ma,massTT);
+        __m256 ratio2 = div8(mb,massTT);
+        __m256 maskA = and8(moving, neq8(ratio1,zero));
+        __m256 maskB = and8(moving, neq8(ratio2,zero));
+        __m256 c = ld8(&L.correction[i]);
+
+        __m256 pax = ld8(&A.px[i]), pay = ld8(&A.py[i]);
+        st8(&A.px[i], select8(pax, add8(pax, mul8(mul8(ld8(&L.n2x[i]),c),ratio1)), maskA));
+        st8(&A.py[i], select8(pay, add8(pay, mul8(mul8(ld8(&L.n2y[i]),c),ratio1)), maskA));
+
+        __m256 pbx = ld8(&B.px[i]), pby = ld8(&B.py[i]);
+        st8(&B.px[i], select8(pbx, add8(pbx, mul8(mul8(ld8(&L.n1x[i]),c),ratio2)), maskB));
+        st8(&B.py[i], select8(pby, add8(pby, mul8(mul8(ld8(&L.n1y[i]),c),ratio2)), maskB));
+    }
+    return i;
+}
+
+// --------------------------------------------------------------------------
+TARGET_AVX2 unsigned impulseAVX2(ContactLanes& L, BodyLanes& S, const float* ix, const float* iy)
+{
+    const Transform& r = responseRot90();
+    __m256 zero = set8(0.f);
+    unsigned i = 0;
+    for(; i+8<=L.size; i+=8)
+    {
+        __m256 jx = ld8(ix+i), jy = ld8(iy+i);
+        __m256 on = neq8(ld8(&S.m[i]),zero);
+        st8(&L.active[i], on);
+
+        __m256 dx = sub8(ld8(&L.hx[i]), ld8(&S.px[i]));
+        __m256 dy = sub8(ld8(&L.hy[i]), ld8(&S.py[i]));
+        __m256 dist = sqrt8(add8(mul8(dx,dx),mul8(dy,dy)));
+        __m256 fx = div8(dx,dist), fy = div8(dy,dist);
+        __m256 tx, ty;
+        rotate8(r, fx, fy, tx, ty);
+
+        __m256 d = add8(mul8(fx,jx),mul8(fy,jy));
+        __m256 vx = ld8(&S.vx[i]), vy = ld8(&S.vy[i]);
+        st8(&S.vx[i], select8(vx, add8(vx,mul8(fx,d)), on));
+        st8(&S.vy[i], select8(vy, add8(vy,mul8(fy,d)), on));
+        st8(&L.angle[i], div8(add8(mul8(jx,tx),mul8(jy,ty)), dist));
+    }
+    return i;
+}
+
+// --------------------------------------------------------------------------
+TARGET_AVX2 unsigned angularAVX2(ContactLanes& L, BodyLanes& S)
+{
+    unsigned i = 0;
+    for(; i+8<=L.size; i+=8)
+    {
+        __m256 w = ld8(&S.w[i]);
+        __m256 angularImpulse = sub8(ld8(&L.angle[i]), w);
+        st8(&S.w[i], select8(w, add8(w,angularImpulse), ld8(&L.active[i])));
+    }
+    return i;
+}
+
+// --------------------------------------------------------------------------
+TARGET_AVX2 unsigned responseBeginAVX2(ContactLanes& L, BodyLanes& S)
+{
+    const Transform& r = responseRot90();
+    unsigned i = 0;
+    for(; i+8<=L.size; i+=8)
+    {
+        __m256 dx = sub8(ld8(&L.hx[i]), ld8(&S.px[i]));
+        __m256 dy = sub8(ld8(&L.hy[i]), ld8(&S.py[i]));
+        __m256 dist = sqrt8(add8(mul8(dx,dx),mul8(dy,dy)));
+        __m256 tx, ty;
+        rotate8(r, div8(dx,dist), div8(dy,dist), tx, ty);
+        st8(&L.tx[i], tx);
+        st8(&L.ty[i], ty);
+        st8(&L.dist[i], dist);
+        st8(&L.angle[i], div8(mul8(ld8(&S.w[i]),set8(3.1415f)),set8(180.f)));
+    }
+    return i;
+}
+
+// --------------------------------------------------------------------------
+TARGET_AVX2 unsigned responseEndAVX2(ContactLanes& L, BodyLanes& S, const BodyLanes& O, const float* nx, const float* ny, float* acc)
+{
+    const Transform& r = responseRot90();
+    __m256 zero = set8(0.f);
+    unsigned i = 0;
+    for(; i+8<=L.size; i+=8)
+    {
+        __m256 ms = ld8(&S.m[i]), mo = ld8(&O.m[i]);
+        __m256 nx8 = ld8(nx+i), ny8 = ld8(ny+i);
+        __m256 sx, sy;
+        rotate8(r, neg8(nx8), neg8(ny8), sx, sy);
+
+        __m256 tv = ld8(&L.angle[i]), dist = ld8(&L.dist[i]);
+        __m256 vcx = add8(ld8(&S.vx[i]), mul8(mul8(ld8(&L.tx[i]),tv),dist));
+        __m256 vcy = add8(ld8(&S.vy[i]), mul8(mul8(ld8(&L.ty[i]),tv),dist));
+
+        __m256 approach = neg8(add8(mul8(nx8,vcx),mul8(ny8,vcy)));
+        __m256 slow = add8(mul8(sx,vcx),mul8(sy,vcy));
+        __m256 response = select8(set8(1.f), div8(ms,add8(ms,mo)), neq8(mo,zero));
+
+        __m256 acc0 = ld8(acc+i);
+        __m256 rate = select8(set8(1.f), response, gt8(approach,zero));
+        __m256 accumulated = max8(add8(acc0,mul8(approach,rate)), zero);
+        __m256 correction = sub8(accumulated, acc0);
+        __m256 bounce = mul8(max8(approach,zero), ld8(&S.restitution[i]));
+        __m256 k = add8(correction, bounce);
+
+        __m256 friction = set8(CONTACT_FRICTION);
+        __m256 on = neq8(ms,zero);
+        __m256 jx = and8(on, sub8(mul8(nx8,k), mul8(mul8(sx,slow),friction)));
+        __m256 jy = and8(on, sub8(mul8(ny8,k), mul8(mul8(sy,slow),friction)));
+
+        st8(acc+i, select8(acc0, accumulated, on));
+        st8(&L.ix[i], jx);
+        st8(&L.iy[i], jy);
+    }
+    return i;
+}
+
+#endif // PHYSIC_X86
+
+
+
+// --------------------------------------------------------------------------
+// each stage runs the vectors of its level, then the scalar code on the lanes left
+void penetration(ContactLanes& L, SimdLevel level)
+{
+    unsigned i = 0;
+#if defined(PHYSIC_X86)
+    if(level == SIMD_AVX2) i = penetrationAVX2(L);
+    else if(level == SIMD_SSE2) i = penetrationSSE2(L);
+#endif
+    penetrationScalar(L, i);
+}
+
+// --------------------------------------------------------------------------
+// applyImpulse
+void impulse(ContactLanes& L, BodyLanes& S, const float* ix, const float* iy, SimdLevel level)
+{
+    unsigned i = 0;
+#if defined(PHYSIC_X86)
+    if(level == SIMD_AVX2) i = impulseAVX2(L, S, ix, iy);
+    else if(level == SIMD_SSE2) i = impulseSSE2(L, S, ix, iy);
+#endif
+    impulseScalar(L, S, ix, iy, i);
+    
+    atanLanes(L);
+    
+    i = 0;
+#if defined(PHYSIC_X86)
+    if(level == SIMD_AVX2) i = angularAVX2(L, S);
+    else if(level == SIMD_SSE2) i = angularSSE2(L, S);
+#endif
+    angularScalar(L, S, i);
+}
+
+// --------------------------------------------------------------------------
+// applyResponse of S against O, correcting its normal impulse acc
+void response(ContactLanes& L, BodyLanes& S, const BodyLanes& O, const float* nx, const float* ny, float* acc, SimdLevel level)
+{
+    unsigned i = 0;
+#if defined(PHYSIC_X86)
+    if(level == SIMD_AVX2) i = responseBeginAVX2(L, S);
+    else if(level == SIMD_SSE2) i = responseBeginSSE2(L, S);
+#endif
+    responseBeginScalar(L, S, i);
+    
+    tanLanes(L);
+    
+    i = 0;
+#if defined(PHYSIC_X86)
+    if(level == SIMD_AVX2) i = responseEndAVX2(L, S, O, nx, ny, acc);
+    else if(level == SIMD_SSE2) i = responseEndSSE2(L, S, O, nx, ny, acc);
+#endif
+    responseEndScalar(L, S, O, nx, ny, acc, i);
+    
+    impulse(L, S, L.ix.data(), L.iy.data(), level);
+}
+
+// --------------------------------------------------------------------------
+void solveContactBatch(Arr<CollisionData>& collisions, const unsigned* contacts, unsigned count, ContactLanes& L, SimdLevel level)
+{
+    L.resize(count);
+    for(unsigned k=0; k<count; ++k)
+    {
+        const CollisionData& c = collisions[ contacts[k] ];
+        L.hx[k] = c.hitPoint.x; L.hy[k] = c.hitPoint.y;
+        L.n1x[k] = c.normal1.x; L.n1y[k] = c.normal1.y;
+        L.n2x[k] = c.normal2.x; L.n2y[k] = c.normal2.y;
+        L.correction[k] = penetrationCorrection(c.penetration);
+        L.i1[k] = c.normalImpulse1;
+        L.i2[k] = c.normalImpulse2;
+        gatherBody(L.a, k, *c.e1);
+        gatherBody(L.b, k, *c.e2);
+    }
+    
+    // resolveCollision
+    penetration(L, level);
+    warmLanes(L, L.a, L.n2x.data(), L.n2y.data(), L.i1.data());
+    warmLanes(L, L.b, L.n1x.data(), L.n1y.data(), L.i2.data());
+    response(L, L.a, L.b, L.n2x.data(), L.n2y.data(), L.i1.data(), level);
+    response(L, L.b, L.a, L.n1x.data(), L.n1y.data(), L.i2.data(), level);
+    
+    for(unsigned k=0; k<count; ++k)
+    {
+        CollisionData& c = collisions[ contacts[k] ];
+        c.normalImpulse1 = L.i1[k];
+        c.normalImpulse2 = L.i2[k];
+        scatterBody(L.a, k, *c.e1);
+        scatterBody(L.b, k, *c.e2);
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef PHYSIC_COLORSOLVER_HPP
+#define PHYSIC_COLORSOLVER_HPP
+
+#include "physic_entity.hpp"
+#include "physic_integrate.hpp"
+
+
+// --------------------------------------------------------------------------
+// contacts split in colors : no 2 contacts of a color move the same body, so the contacts
+// of a color can be solved at the same time (static and massless bodies are only read)
+// greedy coloring in contact order, the result only depends on the contact list
+struct ContactColoring
+{
+    // colors available to a body, the contacts left go to a last color solved one by one
+    static const unsigned MAX_COLORS = 64;
+
+    // contact indices grouped by color, in contact order inside a color
+    // color k covers [start[k];start[k+1])
+    Arr<unsigned> contacts;
+    Arr<unsigned> start;
+
+    // true if the last color holds contacts which could not be colored (they may share bodies)
+    bool overflow;
+
+    ContactColoring();
+    virtual ~ContactColoring();
+
+    // number of colors
+    unsigned size() const;
+
+    // number of contacts of color k
+    unsigned count(unsigned k) const;
+
+    // color the collisions, bodies is the store of the dynamic bodies
+    void build(const Arr<CollisionData>& collisions, const BodyStore& bodies);
+
+    // room for builds of contactCount contacts over bodyCount body slots, without allocation
+    void reserve(unsigned bodyCount, unsigned contactCount);
+
+protected:
+    // per body slot : colors already used by its contacts
+    Arr<unsigned long long> used;
+    Arr<unsigned> touched;
+
+    // color of each contact
+    Arr<unsigned> contactColor;
+};
+
+// --------------------------------------------------------------------------
+// state of one side of the contacts of a batch, one lane per contact
+struct BodyLanes
+{
+    Arr<float> px, py;
+    Arr<float> vx, vy;
+    Arr<float> w;
+    Arr<float> m;
+    Arr<float> restitution;
+
+    void resize(unsigned n);
+};
+
+// --------------------------------------------------------------------------
+// contacts of a batch gathered in arrays (structure of arrays) for the vector kernels
+struct ContactLanes
+{
+    unsigned size;
+
+    // contact data
+    Arr<float> hx, hy;
+    Arr<float> n1x, n1y;
+    Arr<float> n2x, n2y;
+    Arr<float> correction;
+    Arr<float> i1, i2;
+
+    // bodies e1 and e2
+    BodyLanes a;
+    BodyLanes b;
+
+    // intermediate values of the current body : direction from its center to the hit point
+    // and its tangent, distance, impulse, angle term and mask of the lanes to update
+    Arr<float> fx, fy;
+    Arr<float> tx, ty;
+    Arr<float> dist;
+    Arr<float> ix, iy;
+    Arr<float> angle;
+    Arr<float> active;
+
+    ContactLanes();
+
+    void resize(unsigned n);
+
+    // room for n contacts (size unchanged)
+    void reserve(unsigned n);
+};
+
+// --------------------------------------------------------------------------
+// solve count contacts of a color (they must not move the same body), same result as
+// PhysicEngine::resolveCollision on each of them : the scalar lanes run the response stages
+// of physic_response.hpp shared with the engine, the vector kernels repeat their operations
+// in the same order (PhysicSim determinism compares every level), and tan / atan are computed
+// per lane with the std functions, so vectorized levels are bit-identical to the scalar one
+void solveContactBatch(Arr<CollisionData>& collisions, const unsigned* contacts, unsigned count, ContactLanes& lanes, SimdLevel level);
+
+
+#endif // PHYSIC_COLORSOLVER_HPP
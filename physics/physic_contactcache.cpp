@@ -0,0 +1,194 @@
+#include "physic_contactcache.hpp"
+#include "../maths/math_intersection.hpp"
+#include <algorithm>
+#include <functional>
+
+// --------------------------------------------------------------------------
+// pair (a1,a2) before pair (b1,b2), std::less : the bodies are not in one array
+bool bodiesLess(const Entity* a1, const Entity* a2, const Entity* b1, const Entity* b2)
+{
+    std::less<const Entity*> less;
+    if(a1 != b1) return less(a1, b1);
+    return less(a2, b2);
+}
+
+// --------------------------------------------------------------------------
+bool pairLess(const CachedContact& c, const std::pair<Entity*,Entity*>& key)
+{
+    return bodiesLess(c.e1, c.e2, key.first, key.second);
+}
+
+// --------------------------------------------------------------------------
+ContactCache::ContactCache()
+    : warmStartFactor(0.8f)
+    , matchDistance(4.f)
+    , matchCosine(0.9f)
+    , keepSteps(4)
+{}
+
+// --------------------------------------------------------------------------
+ContactCache::~ContactCache() {}
+
+// --------------------------------------------------------------------------
+unsigned ContactCache::warmStart(Arr<CollisionData>& collisions) const
+{
+    unsigned matched = 0;
+    if(warmStartFactor == 0.f || contacts.empty()) return matched;
+    
+    for(auto& coll : collisions)
+    {
+        auto key = std::make_pair(coll.e1,coll.e2);
+        auto it = std::lower_bound(contacts.begin(), contacts.end(), key, pairLess);
+        if( it == contacts.end() || it->e1 != coll.e1 || it->e2 != coll.e2 ) continue;
+        
+        // the contact has changed too much to reuse its impulse
+        if( len2(it->hitPoint - coll.hitPoint) > matchDistance*matchDistance ) continue;
+        if( dot(it->normal1, coll.normal1) < matchCosine ) continue;
+        
+        coll.normalImpulse1 = it->normalImpulse1 * warmStartFactor;
+        coll.normalImpulse2 = it->normalImpulse2 * warmStartFactor;
+        matched++;
+    }
+    return matched;
+}
+
+// --------------------------------------------------------------------------
+void ContactCache::store(const Arr<CollisionData>& collisions)
+{
+    auto less = [](const CachedContact& c1, const CachedContact& c2)
+    {
+        return bodiesLess(c1.e1, c1.e2, c2.e1, c2.e2);
+    };
+    
+    buffer.clear();
+    for(auto& coll : collisions)
+    {
+        buffer.push_back( {coll.e1, coll.e2, coll.hitPoint, coll.normal1, coll.normal2, coll.normalImpulse1, coll.normalImpulse2, 0} );
+    }
+    std::sort(buffer.begin(), buffer.end(), less);
+    
+    // previous contacts not found again, until they are too old
+    unsigned found = buffer.size();
+    for(auto& c : contacts)
+    {
+        if(c.age >= keepSteps) continue;
+        
+        auto key = std::make_pair(c.e1,c.e2);
+        auto it = std::lower_bound(buffer.begin(), buffer.begin() + found, key, pairLess);
+        if( it != buffer.begin() + found && it->e1 == c.e1 && it->e2 == c.e2 ) continue;
+        
+        buffer.push_back(c);
+        buffer.back().age++;
+    }
+    if(buffer.size() > found) std::sort(buffer.begin(), buffer.end(), less);
+    
+    contacts.swap(buffer);
+}
+
+// --------------------------------------------------------------------------
+void ContactCache::clear()
+{
+    contacts.clear();
+}
+
+// --------------------------------------------------------------------------
+void ContactCache::reserve(unsigned count)
+{
+    contacts.reserve(count);
+    buffer.reserve(count);
+}
+
+
+
+
+// --------------------------------------------------------------------------
+bool axisLess(const CachedAxis& c, const std::pair<Entity*,Entity*>& key)
+{
+    return bodiesLess(c.e1, c.e2, key.first, key.second);
+}
+
+// --------------------------------------------------------------------------
+AxisScratch::AxisScratch()
+    : tests(0)
+    , hits(0)
+{}
+
+// --------------------------------------------------------------------------
+void AxisScratch::clear()
+{
+    found.clear();
+    tests = 0;
+    hits = 0;
+}
+
+
+
+// --------------------------------------------------------------------------
+AxisCache::AxisCache()
+    : tests(0)
+    , hits(0)
+{}
+
+// --------------------------------------------------------------------------
+AxisCache::~AxisCache() {}
+
+// --------------------------------------------------------------------------
+void AxisCache::beginStep()
+{
+    std::sort(found.begin(), found.end(), [](const CachedAxis& c1, const CachedAxis& c2)
+    {
+        return bodiesLess(c1.e1, c1.e2, c2.e1, c2.e2);
+    });
+    axes.swap(found);
+    found.clear();
+    
+    tests = 0;
+    hits = 0;
+}
+
+// --------------------------------------------------------------------------
+bool AxisCache::collide(const RectEntity& r1, const RectEntity& r2, CollisionData& res, AxisScratch& scratch, ScratchArena& arena) const
+{
+    Entity* e1 = const_cast<RectEntity*>(&r1);
+    Entity* e2 = const_cast<RectEntity*>(&r2);
+    scratch.tests++;
+    
+    // single projection test on the previous separating axis
+    auto key = std::make_pair(e1,e2);
+    auto it = std::lower_bound(axes.begin(), axes.end(), key, axisLess);
+    if( it != axes.end() && it->e1 == e1 && it->e2 == e2 && separatedOnAxis(r1, r2, it->axis) )
+    {
+        scratch.found.push_back(*it);
+        scratch.hits++;
+        return false;
+    }
+    
+    if( Rect2Rect(r1, r2, res, arena) ) return true;
+    
+    // remember why they do not collide
+    Vec2 axis;
+    if( findSeparatingAxis(r1, r2, axis) ) scratch.found.push_back( {e1, e2, axis} );
+    return false;
+}
+
+// --------------------------------------------------------------------------
+void AxisCache::merge(const AxisScratch& scratch)
+{
+    found.insert(found.end(), scratch.found.begin(), scratch.found.end());
+    tests += scratch.tests;
+    hits += scratch.hits;
+}
+
+// --------------------------------------------------------------------------
+void AxisCache::clear()
+{
+    axes.clear();
+    found.clear();
+}
+
+// --------------------------------------------------------------------------
+void AxisCache::reserve(unsigned count)
+{
+    axes.reserve(count);
+    found.reserve(count);
+}
@@ -0,0 +1,127 @@
+#ifndef PHYSIC_CONTACTCACHE_HPP
+#define PHYSIC_CONTACTCACHE_HPP
+
+#include "physic_entity.hpp"
+
+
+// --------------------------------------------------------------------------
+// contact kept from one step to the next
+struct CachedContact
+{
+    Entity* e1;
+    Entity* e2;
+    
+    Vec2 hitPoint;
+    Vec2 normal1;
+    Vec2 normal2;
+    
+    // normal impulses accumulated on e1 and e2, without the restitution
+    float normalImpulse1;
+    float normalImpulse2;
+    
+    // steps since the contact was last found
+    unsigned age;
+};
+
+// --------------------------------------------------------------------------
+// persistent contacts keyed by body pair, used to warm start the solver
+// the store is rebuilt at each step, contacts which disappeared are dropped after keepSteps
+struct ContactCache
+{
+    // contacts of the last steps, sorted by pair
+    Arr<CachedContact> contacts;
+    
+    // part of the previous normal impulse applied as starting point [0;1] (0 disables warm starting)
+    float warmStartFactor;
+    
+    // a contact is matched only if its hit point moved less than this distance
+    float matchDistance;
+    
+    // ... and if its normal turned less than this (cosine)
+    float matchCosine;
+    
+    // steps a contact is kept after its bodies stopped touching : a resting body pushed out of
+    // the contact (and bouncing) comes back on it a few steps later
+    unsigned keepSteps;
+    
+    ContactCache();
+    virtual ~ContactCache();
+    
+    // give the new collisions the normal impulses of their cached contact
+    // return the number of matched contacts
+    unsigned warmStart(Arr<CollisionData>& collisions) const;
+    
+    // keep the solved collisions for the next steps, with the recent contacts not found again
+    void store(const Arr<CollisionData>& collisions);
+    
+    // drop all contacts
+    void clear();
+    
+    // room for count contacts, so that store does not allocate
+    void reserve(unsigned count);
+    
+protected:
+    Arr<CachedContact> buffer;
+};
+
+// --------------------------------------------------------------------------
+// last separating axis found between 2 rectangles
+struct CachedAxis
+{
+    Entity* e1;
+    Entity* e2;
+    Vec2 axis;
+};
+
+// --------------------------------------------------------------------------
+// axes found and counters of a part of the narrowphase (one per thread), merged into the cache
+struct AxisScratch
+{
+    Arr<CachedAxis> found;
+    unsigned tests;
+    unsigned hits;
+    
+    AxisScratch();
+    
+    void clear();
+};
+
+// --------------------------------------------------------------------------
+// temporal coherence for rectangle pairs : close but separated rectangles generally stay so
+// the axis which separated a pair at the previous step is tested before the full Rect2Rect
+struct AxisCache
+{
+    // axes found at the previous step, sorted by pair
+    Arr<CachedAxis> axes;
+    
+    // counters since beginStep : rectangle pairs tested and pairs rejected by their cached axis
+    unsigned tests;
+    unsigned hits;
+    
+    AxisCache();
+    virtual ~AxisCache();
+    
+    // start a new step (the axes found since the previous call become the cache)
+    void beginStep();
+    
+    // collision test of 2 rectangles, using the cached axis first
+    // the new axis and counters go to scratch, so threads can test pairs concurrently
+    // the contact points of the full test are taken from arena
+    bool collide(const RectEntity& r1, const RectEntity& r2, CollisionData& res, AxisScratch& scratch, ScratchArena& arena) const;
+    
+    // add the axes and counters of a scratch to the current step
+    void merge(const AxisScratch& scratch);
+    
+    // drop all axes
+    void clear();
+    
+    // room for count axes, so that merge does not allocate
+    void reserve(unsigned count);
+    
+protected:
+    // axes found during the current step
+    Arr<CachedAxis> found;
+};
+
+
+#endif // PHYSIC_CONTACTCACHE_HPP
@@ -1,14 +1,145 @@
 #include "physic_engine.hpp"
+#include "physic_response.hpp"
+#include "../maths/math_intersection.hpp"
 #include <cmath>
+#include <algorithm>
 #include <iostream>
 
 #define GRAVITY 9.80665
 #define PIXEL_PER_METER 2
 
+// candidate pairs (and contacts) per body the step buffers are sized for : piles of rectangles
+// or circles have less than 3
+#define PAIRS_PER_BODY 4
+
+// the circle pairs grouping mode not in use is tried for CIRCLE_PROBE_LENGTH steps every CIRCLE_PROBE_STEPS
+#define CIRCLE_PROBE_STEPS 240
+#define CIRCLE_PROBE_LENGTH 4
+
 // --------------------------------------------------------------------------
-PhysicEngine::PhysicEngine()
+PhysicStats::PhysicStats()
 {
-    
+    reset();
+}
+
+// --------------------------------------------------------------------------
+void PhysicStats::reset()
+{
+    filteredPairs = 0;
+    warmStartedContacts = 0;
+    rectPairTests = 0;
+    separatingAxisHits = 0;
+    circlePairs = 0;
+    batchedCirclePairs = 0;
+    circleBatches = 0;
+    candidatePairs = 0;
+    narrowphaseTests = 0;
+    contacts = 0;
+    islands = 0;
+    largestIsland = 0;
+    contactColors = 0;
+    integratedBodies = 0;
+    sleepingBodies = 0;
+    wokenBodies = 0;
+    for(auto& t : phaseTime) t = 0.0;
+    stepTime = 0.0;
+    broadphaseTime = 0.0;
+    narrowphaseTime = 0.0;
+}
+
+// --------------------------------------------------------------------------
+float PhysicStats::axisCacheHitRate() const
+{
+    if(rectPairTests == 0) return 0.f;
+    return (float)separatingAxisHits / rectPairTests;
+}
+
+// --------------------------------------------------------------------------
+float PhysicStats::circleBatchFill() const
+{
+    if(circleBatches == 0) return 0.f;
+    return (float)batchedCirclePairs / circleBatches;
+}
+
+
+
+// --------------------------------------------------------------------------
+FrameStats::FrameStats()
+{
+    reset();
+}
+
+// --------------------------------------------------------------------------
+void FrameStats::reset()
+{
+    steps = 0;
+    deferredSteps = 0;
+    droppedSteps = 0;
+    overBudget = false;
+    time = 0.0;
+}
+
+
+
+// --------------------------------------------------------------------------
+NarrowphaseChunk::NarrowphaseChunk()
+    : tests(0)
+    , circlePairs(0)
+    , batchedCirclePairs(0)
+    , circleBatches(0)
+{}
+
+// --------------------------------------------------------------------------
+void NarrowphaseChunk::clear()
+{
+    collisions.clear();
+    pairIndex.clear();
+    axes.clear();
+    arena.reset();
+    tests = 0;
+    circlePairs = 0;
+    batchedCirclePairs = 0;
+    circleBatches = 0;
+}
+
+
+
+// --------------------------------------------------------------------------
+PhysicEngine::PhysicEngine(Broadphase* bp, ThreadPool* tp)
+    : broadphase(bp)
+    , deterministic(false)
+    , circleBatching(BATCH_AUTO)
+    , solverMode(SOLVER_ISLANDS)
+    , colorGrain(256)
+    , allowSleep(false)
+    , sleepDelay(1.f)
+    , sleepLinear(0.03f)
+    , sleepAngular(0.25f)
+    , fixedStep(1.f/60.f)
+    , maxSubsteps(4)
+    , frameBudget(0.0)
+    , deferSteps(false)
+    , accumulator(0.f)
+    , alpha(0.f)
+    , pool(tp)
+    , ownPool(tp == nullptr)
+    , narrowphaseGrain(256)
+    , simdLevel( detectSimdLevel() )
+    , profiler(nullptr)
+    , trace(nullptr)
+    , sleepingCount(0)
+    , nextSleepGroup(1)
+    , groupCircles(false)
+    , circleProbe(0)
+    , pairCost(0.0)
+    , groupedCost(0.0)
+    , pairsGrouped(false)
+    , reservedBodies(0)
+    , phaseStart(0)
+{
+    if(broadphase == nullptr) broadphase = new SweepAndPrune();
+    if(ownPool) pool = new ThreadPool(1);
+
     const float SPEED_FACTOR = 1.0/PIXEL_PER_METER;
     gravityVec = Vec2(0.f,1.f);
     gravityForce = GRAVITY * SPEED_FACTOR;
@@ -17,84 +148,330 @@ PhysicEngine::PhysicEngine()
 // --------------------------------------------------------------------------
 PhysicEngine::~PhysicEngine()
 {
+    delete broadphase;
+    if(ownPool) delete pool;
+    
+    // entities may outlive the engine
+    while( bodies.size() > 0 ) BodyStore::shared().adopt( bodies.owner.back() );
+    while( staticBodies.size() > 0 ) BodyStore::shared().adopt( staticBodies.owner.back() );
+}
+
+// --------------------------------------------------------------------------
+bool isStatic(Entity* e)
+{
+    if(e->shape != SHAPE_GROUP) return e->mass() == 0.f;
+    
+    for(auto& e2 : static_cast<GroupEntity*>(e)->entities)
+        if( !isStatic(e2) ) return false;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+// move the shape model of an entity to its body position
+void updateShape(Entity* e)
+{
+    if(e->shape == SHAPE_RECT)
+    {
+        RectEntity* re = static_cast<RectEntity*>(e);
+        re->change(); re->update();
+    }
+    else if(e->shape == SHAPE_CIRCLE)
+    {
+        CircleEntity* ce = static_cast<CircleEntity*>(e);
+        ce->center=ce->position();
+    }
 }
 
 // --------------------------------------------------------------------------
 void PhysicEngine::addEntity(Entity* e)
 {
     entities.push_back(e);
+    
+    // out of the shared store first : other threads may be creating entities in it
+    Arr<Entity*> leaves;
+    expandBodies(e, leaves);
+    for(auto& b : leaves) bodies.adopt(b);
+    
+    if( isStatic(e) )
+    {
+        // from the end, the slots of the dynamic bodies do not change
+        for(unsigned i=leaves.size(); i-- > 0; ) staticBodies.adopt(leaves[i]);
+        
+        // sleeping bodies would never see it
+        if(sleepingCount > 0) wakeAround(e);
+        
+        staticGeometry.add(e);
+        return;
+    }
+    
+    dynamicEntities.push_back(e);
+    
+    // shapes are placed now, not at the end of the first step
+    for(auto& b : leaves) updateShape(b);
+}
+
+// --------------------------------------------------------------------------
+void PhysicEngine::removeEntity(Entity* e)
+{
+    auto it = std::find(entities.begin(), entities.end(), e);
+    if( it == entities.end() ) return;
+    entities.erase(it);
+    
+    // bodies resting on e must fall
+    if(sleepingCount > 0) wakeAround(e);
+    
+    auto dyn = std::find(dynamicEntities.begin(), dynamicEntities.end(), e);
+    if( dyn != dynamicEntities.end() )
+    {
+        dynamicEntities.erase(dyn);
+        
+        Arr<Entity*> leaves;
+        expandBodies(e, leaves);
+        for(auto& b : leaves)
+        {
+            if( sleeping(b) ) sleepingCount--;
+            BodyStore::shared().adopt(b);
+        }
+    }
+    else
+    {
+        Arr<Entity*> leaves;
+        expandBodies(e, leaves);
+        for(auto& b : leaves) BodyStore::shared().adopt(b);
+        
+        // the static structure is immutable : rebuilt without e
+        staticGeometry.clear();
+        for(auto& e2 : entities)
+            if( isStatic(e2) ) staticGeometry.add(e2);
+    }
+    
+    // cached pairs may refer to e
+    contactCache.clear();
+    axisCache.clear();
+    collisions.clear();
+}
+
+// --------------------------------------------------------------------------
+Entity* PhysicEngine::getEntity(BodyHandle h) const
+{
+    return bodies.get(h);
 }
 
 // --------------------------------------------------------------------------
 void PhysicEngine::updateEntities(float elapsedSec)
 {
+    TraceScope scope(trace, "step");
+    stats.reset();
+    
+    // sleeping turned off : every body wakes
+    if(!allowSleep && sleepingCount > 0)
+        for(auto g : bodies.sleepGroup) if(g != 0) wakeRequests.push_back(g);
+    if( !wakeRequests.empty() ) applyWakes();
+    
+    if(bodies.size() > reservedBodies) reserveBuffers();
+    
+    // pose before the step, for interpolation and for the rest test
+    bodies.previousPosition = bodies.position;
+    bodies.previousRotation = bodies.rotation;
+    
+    // idle world : nothing moves until a body is woken
+    if(allowSleep && bodies.size() > 0 && sleepingCount == bodies.size())
+    {
+        pairs.clear();
+        collisions.clear();
+        stats.sleepingBodies = sleepingCount;
+        return;
+    }
+    
+    beginPhase(PHASE_GRAVITY);
     applyGravity(elapsedSec);
+    endPhase(PHASE_GRAVITY);
     
+    beginPhase(PHASE_COLLECT);
     collectCollisions();
+    endPhase(PHASE_COLLECT);
+    
+    beginPhase(PHASE_RESOLVE);
     resolveCollisions(elapsedSec);
+    endPhase(PHASE_RESOLVE);
+    
+    beginPhase(PHASE_ADVANCE);
     advanceTransformation(elapsedSec);
+    updateSleep(elapsedSec);
+    endPhase(PHASE_ADVANCE);
+    
+    stats.sleepingBodies = sleepingCount;
+    for(auto& t : stats.phaseTime) stats.stepTime += t;
 }
 
 // --------------------------------------------------------------------------
-void PhysicEngine::resolvePenetration(CollisionData& collision)
+void PhysicEngine::reserveBuffers()
 {
-    Entity& e1  = *collision.e1;
-    Entity& e2  = *collision.e2;
+    // bodies added one at a time do not resize everything at each step
+    reservedBodies = bodies.size() + bodies.size()/2;
+    unsigned pairCount = reservedBodies * PAIRS_PER_BODY;
+    
+    // the static pairs are appended to pairs, PAIRS_PER_BODY counts them too
+    pairs.reserve(pairCount);
+    broadphase->reserve(pairCount);
+    collisions.reserve(pairCount);
+    contactCache.reserve(pairCount);
+    axisCache.reserve(pairCount);
+    islands.reserve(reservedBodies, pairCount);
+    sleepIslands.reserve(reservedBodies, pairCount);
+    if(allowSleep) wakeRequests.reserve(pairCount);
+    if(deterministic) keyedPairs.reserve(pairCount);
+    if(circleBatchWidth(simdLevel) > 0)
+    {
+        groupedPairs.reserve(pairCount);
+        circleCounts.reserve(reservedBodies);
+        groupedList.reserve(pairCount);
+        groupedIndex.reserve(pairCount);
+        groupedFlipped.reserve(pairCount);
+        pairCollision.reserve(pairCount);
+        restoredCollisions.reserve(pairCount);
+    }
+    
+    // a chunk gets narrowphaseGrain pairs at most
+    unsigned chunkCount = (pairCount + narrowphaseGrain - 1) / narrowphaseGrain;
+    if(chunks.size() < chunkCount) chunks.resize(chunkCount);
+    for(auto& chunk : chunks)
+    {
+        chunk.collisions.reserve(narrowphaseGrain);
+        chunk.pairIndex.reserve(narrowphaseGrain);
+        chunk.axes.found.reserve(narrowphaseGrain);
+        
+        // a run of circle pairs does not cross its chunk
+        if(circleBatchWidth(simdLevel) > 0) chunk.circleBatch.reserve(narrowphaseGrain);
+    }
+    
+    if(solverMode == SOLVER_COLORED)
+    {
+        coloring.reserve(reservedBodies, pairCount);
+        
+        // a color has all the contacts in the worst case
+        unsigned laneCount = (pairCount + colorGrain - 1) / colorGrain;
+        if(colorLanes.size() < laneCount) colorLanes.resize(laneCount);
+        for(auto& lanes : colorLanes) lanes.reserve(colorGrain);
+    }
+}
+
+// --------------------------------------------------------------------------
+unsigned PhysicEngine::stepFrame(float frameSec)
+{
+    frameStats.reset();
+    unsigned long long start = traceClock();
+    
+    accumulator += std::max(frameSec, 0.f);
+    
+    double lastStep = 0.0;
+    while(accumulator >= fixedStep && frameStats.steps < maxSubsteps)
+    {
+        // the next step is expected to cost as much as the last one
+        double spent = (traceClock() - start) * 1e-6;
+        if(frameBudget > 0.0 && frameStats.steps > 0 && spent + lastStep > frameBudget)
+        {
+            frameStats.overBudget = true;
+            break;
+        }
+        
+        unsigned long long stepStart = traceClock();
+        updateEntities(fixedStep);
+        accumulator -= fixedStep;
+        frameStats.steps++;
+        lastStep = (traceClock() - stepStart) * 1e-6;
+    }
+    
+    // late steps are not all run by the next frames : a slow step would make the frames
+    // slower and slower (each one having more steps to catch up)
+    unsigned left = (unsigned)(accumulator / fixedStep);
+    unsigned kept = deferSteps ? std::min(left, maxSubsteps) : 0;
+    frameStats.deferredSteps = kept;
+    frameStats.droppedSteps = left - kept;
+    accumulator -= frameStats.droppedSteps * fixedStep;
+    
+    alpha = std::min(accumulator / fixedStep, 1.f);
+    frameStats.time = (traceClock() - start) * 1e-6;
+    return frameStats.steps;
+}
+
+// --------------------------------------------------------------------------
+Vec2 PhysicEngine::interpolatedPosition(const Entity* e) const
+{
+    if(e->store != &bodies) return e->position();
+    
+    unsigned s = e->bodySlot;
+    return (bodies.position[s] - bodies.previousPosition[s]) * alpha + bodies.previousPosition[s];
+}
 
-    float massTT = e1.mass + e2.mass;
-    if(massTT == 0.f) return;
+// --------------------------------------------------------------------------
+float PhysicEngine::interpolatedRotation(const Entity* e) const
+{
+    if(e->store != &bodies) return e->rotation();
     
-    float ratio1 = e1.mass / massTT;
-    float ratio2 = e2.mass / massTT;
+    unsigned s = e->bodySlot;
+    return bodies.previousRotation[s] + (bodies.rotation[s] - bodies.previousRotation[s]) * alpha;
+}
 
-    const float EPSILON = 0.02;
-    float correction = (float)collision.penetration * (1.0+EPSILON);
+// --------------------------------------------------------------------------
+void PhysicEngine::beginPhase(PhysicPhase phase)
+{
+    if(profiler) profiler->beginPhase(phase);
+    phaseStart = traceClock();
+}
 
-    e1.position += collision.normal2 * correction * ratio1;
-    e2.position += collision.normal1 * correction * ratio2;
+// --------------------------------------------------------------------------
+void PhysicEngine::endPhase(PhysicPhase phase)
+{
+    unsigned long long end = traceClock();
+    stats.phaseTime[phase] = (end - phaseStart) * 1e-6;
+    if(trace) trace->record(phaseName(phase), phaseStart, end);
+    
+    if(profiler) profiler->endPhase(phase);
 }
 
 // --------------------------------------------------------------------------
-void PhysicEngine::applyResponse(Entity& e1, const Vec2& hitPoint, const Vec2& normal2,Entity& e2)
+void PhysicEngine::resolvePenetration(CollisionData& collision)
 {
-    sf::Transform rot90; rot90.rotate(90.0);
-    Vec2 fromO = hitPoint - e1.position;
-    fromO = normalize(fromO);
-    Vec2 tan = rot90 * fromO;
+    Entity& e1  = *collision.e1;
+    Entity& e2  = *collision.e2;
 
-    Vec2 surface2 = rot90 * -normal2;
+    // static bodies are shared by islands solved in parallel : never written
+    separateBodies(e1.mass(), e2.mass(), penetrationCorrection(collision.penetration),
+                   collision.normal1, collision.normal2, e1.position(), e2.position());
+}
 
-    if(e1.mass != 0.f)
+// --------------------------------------------------------------------------
+void PhysicEngine::applyResponse(Entity& e1, const Vec2& hitPoint, const Vec2& normal2,Entity& e2, float& normalImpulse)
+{
+    if(e1.mass() != 0.f)
     {
-        float hitPoint_dist = len( hitPoint - e1.position );
-        float tanVel_value = std::tan(e1.v_angular * 3.1415f / 180.f);
-        Vec2 tanVel = tan * tanVel_value * hitPoint_dist;
-        Vec2 velocityAtContact = e1.v_linear + tanVel;		
-        
-        // velocity
-        float impulse = std::max( -dot(normal2,velocityAtContact) , 0.0f);
-        const float friction = 0.7;
-        float slow = dot(surface2,velocityAtContact);
-        float response = 1.0;
-        if(e2.mass != 0.f)
-        {
-            response = e1.mass / (e1.mass + e2.mass);
-        }
-        float restitution = e1.restitution;
-        Vec2 impulseVec = normal2 * impulse * (float)(response + restitution);
-        impulseVec -= surface2 * slow * (float)(friction);
+        // start from the normal impulse of the previous step (warm start), a push along the normal
+        e1.v_linear() += normal2 * normalImpulse;
         
-        // linear velocity
-        e1.v_linear += fromO*dot(fromO, impulseVec);
+        Vec2 tan;
+        float hitPoint_dist;
+        responseTangent(hitPoint, e1.position(), tan, hitPoint_dist);
+        float tanVel_value = std::tan( responseAngle(e1.v_angular()) );
+        Vec2 impulseVec = responseImpulse(tan, tanVel_value, hitPoint_dist, e1.v_linear(), normal2, e1.mass(), e2.mass(), e1.restitution(), normalImpulse);
         
-        // angular velocity
-        float tanImpulse = dot(impulseVec,tan);
-        float angularImpulse = std::atan(tanImpulse / hitPoint_dist) * 180.0 / 3.1415;
-        angularImpulse -= e1.v_angular;// * (response + restitution);
-        e1.v_angular += angularImpulse;
+        applyImpulse(e1, hitPoint, impulseVec);
     }
 }
 
+// --------------------------------------------------------------------------
+void PhysicEngine::applyImpulse(Entity& e1, const Vec2& hitPoint, const Vec2& impulseVec)
+{
+    if(e1.mass() == 0.f) return;
+    
+    // the solver only meets awake bodies : a sleeping one is pushed from outside
+    if( sleeping(&e1) ) wake(&e1);
+    
+    // linear velocity, then angular velocity
+    float tanImpulse = impulseLinear(hitPoint, e1.position(), impulseVec, e1.v_linear());
+    impulseAngular(impulseAngle(tanImpulse), e1.v_angular());
+}
+
 // --------------------------------------------------------------------------
 void PhysicEngine::resolveCollision(CollisionData& collision)
 {
@@ -103,91 +480,547 @@ void PhysicEngine::resolveCollision(CollisionData& collision)
 
     resolvePenetration(collision);
 
-    applyResponse(e1, collision.hitPoint, collision.normal2,e2);
-    applyResponse(e2, collision.hitPoint, collision.normal1,e1);
+    applyResponse(e1, collision.hitPoint, collision.normal2,e2, collision.normalImpulse1);
+    applyResponse(e2, collision.hitPoint, collision.normal1,e1, collision.normalImpulse2);
 }
 
 // --------------------------------------------------------------------------
 void PhysicEngine::applyGravity(float elapsedSec)
 {
-    for(auto& e:entities)
-    {
-        if(e->mass != 0.f)
-            e->v_linear += gravityVec * gravityForce * elapsedSec;
-    }
+    integrateGravity(bodies, gravityVec * gravityForce * elapsedSec, simdLevel);
 }
 
 // --------------------------------------------------------------------------
 void PhysicEngine::collectCollisions()
 {
     collisions.clear();
+    
+    unsigned long long start = traceClock();
+    pairs.clear();
+    {
+        TraceScope scope(trace, "broadphase");
+        broadphase->update(dynamicEntities);
+        broadphase->findPairs(pairs);
+    }
+    {
+        TraceScope scope(trace, "static geometry");
+        staticGeometry.findPairs(broadphase->bodies, broadphase->boxes, pairs);
+    }
+    stats.filteredPairs = broadphase->filteredPairs + staticGeometry.filteredPairs;
+    stats.broadphaseTime = (traceClock() - start) * 1e-6;
+    
+    if(sleepingCount > 0) wakePairs();
+    stats.candidatePairs = pairs.size();
+    
+    start = traceClock();
+    if(deterministic) sortPairs();
+    pairsGrouped = groupCircles && circleBatchWidth(simdLevel) > 0 && groupCirclePairs();
+    
+    TraceScope scope(trace, "narrowphase");
+    axisCache.beginStep();
+    
+    // independent read-only tests : chunks run in parallel, each in its own buffers
+    unsigned chunkCount = (pairs.size() + narrowphaseGrain - 1) / narrowphaseGrain;
+    if(chunks.size() < chunkCount) chunks.resize(chunkCount);
+    pool->parallelFor(pairs.size(), narrowphaseGrain, [this](unsigned begin, unsigned end)
+    {
+        narrowphaseRange(begin, end, chunks[begin / narrowphaseGrain]);
+    });
+    
+    // merged in chunk order, so collisions keep the order of the pairs whatever the thread count
+    for(unsigned k=0; k<chunkCount; ++k)
+    {
+        NarrowphaseChunk& chunk = chunks[k];
+        collisions.insert(collisions.end(), chunk.collisions.begin(), chunk.collisions.end());
+        axisCache.merge(chunk.axes);
+        stats.narrowphaseTests += chunk.tests;
+        stats.circlePairs += chunk.circlePairs;
+        stats.batchedCirclePairs += chunk.batchedCirclePairs;
+        stats.circleBatches += chunk.circleBatches;
+    }
+    if(pairsGrouped) restorePairOrder(chunkCount);
+    stats.narrowphaseTime = (traceClock() - start) * 1e-6;
+    stats.rectPairTests = axisCache.tests;
+    stats.separatingAxisHits = axisCache.hits;
+    stats.contacts = collisions.size();
+    
+    // grouping costs a pass over the pairs and the reordering of the collisions, and a circle
+    // pile has about 3 candidates per body : it is kept only while its narrowphase time per pair
+    // is below the one of the pair tests, the other way is tried from time to time
+    if(circleBatchWidth(simdLevel) == 0 || stats.circlePairs == 0 || circleBatching != BATCH_AUTO)
+    {
+        groupCircles = circleBatching == BATCH_ALWAYS;
+    }
+    else
+    {
+        // averaged over the last steps of each way, and a margin : the timing noise of a few steps
+        // does not keep a slower grouping
+        double cost = stats.narrowphaseTime / stats.candidatePairs;
+        double& mean = pairsGrouped ? groupedCost : pairCost;
+        mean = mean > 0.0 ? mean * 0.75 + cost * 0.25 : cost;
+        
+        bool faster = groupedCost > 0.0 && groupedCost < pairCost * 0.9;
+        circleProbe = (circleProbe + 1) % CIRCLE_PROBE_STEPS;
+        groupCircles = circleProbe < CIRCLE_PROBE_LENGTH ? !faster : faster;
+    }
+    
+    stats.warmStartedContacts = contactCache.warmStart(collisions);
+}
 
-    Arr< std::pair<Entity*,Entity*> > pairs;
-    for(auto& e1 : entities)
+// --------------------------------------------------------------------------
+unsigned PhysicEngine::bodyKey(const Entity* e) const
+{
+    if(e->store == &bodies) return e->bodySlot;
+    return 0x80000000u | staticGeometry.indexOf(e);
+}
+
+// --------------------------------------------------------------------------
+// pairs oriented (lowest key first) then sorted by (key e1, key e2), keys are unique per pair
+void PhysicEngine::sortPairs()
+{
+    TraceScope scope(trace, "sort pairs");
+    
+    keyedPairs.resize(pairs.size());
+    for(unsigned i=0; i<pairs.size(); ++i)
     {
-        if( dynamic_cast<GroupEntity*>(e1) ) continue;
-            
-        for(auto& e2 : entities)
+        EntityPair p = pairs[i];
+        unsigned k1 = bodyKey(p.e1), k2 = bodyKey(p.e2);
+        if(k1 > k2)
         {
-            auto p = std::make_pair(e1,e2);
-            auto it = std::find(pairs.begin(),pairs.end(),p);
-            if( e1==e2 || it!=pairs.end() ) continue;
-            
+            std::swap(p.e1, p.e2);
+            std::swap(k1, k2);
+        }
+        keyedPairs[i].key = ((unsigned long long)k1 << 32) | k2;
+        keyedPairs[i].pair = p;
+    }
+    
+    std::sort(keyedPairs.begin(), keyedPairs.end(), [](const KeyedPair& a, const KeyedPair& b)
+    {
+        return a.key < b.key;
+    });
+    
+    for(unsigned i=0; i<pairs.size(); ++i) pairs[i] = keyedPairs[i].pair;
+}
+
+// --------------------------------------------------------------------------
+bool circlePair(const EntityPair& p)
+{
+    return p.e1->shape == SHAPE_CIRCLE && p.e2->shape == SHAPE_CIRCLE;
+}
+
+// --------------------------------------------------------------------------
+// the broadphases orient pairs by body index, so the candidates of a body are spread among
+// the pairs of its neighbours : circle pairs are moved after the others and grouped per body
+// (counting sort), each one under the body having the most circle pairs, for full batches
+// pairs is left unchanged, the grouped copy goes to groupedList (false if no circle pair)
+bool PhysicEngine::groupCirclePairs()
+{
+    TraceScope scope(trace, "group circle pairs");
+    
+    // the other pairs keep their order, circle pairs are counted per body
+    const unsigned NO_SLOT = ~0u;
+    unsigned n = bodies.size();
+    circleCounts.assign(n+1, 0);
+    groupedPairs.clear();
+    groupedList.clear();
+    groupedIndex.clear();
+    groupedFlipped.clear();
+    for(unsigned i=0; i<pairs.size(); ++i)
+    {
+        const EntityPair& p = pairs[i];
+        if( !circlePair(p) )
+        {
+            groupedList.push_back(p);
+            groupedIndex.push_back(i);
+            groupedFlipped.push_back(0);
+            continue;
+        }
+        
+        CirclePair cp = { p, p.e1->store == &bodies ? p.e1->bodySlot : NO_SLOT, p.e2->store == &bodies ? p.e2->bodySlot : NO_SLOT, i, false };
+        if(cp.slot1 != NO_SLOT) circleCounts[cp.slot1]++;
+        if(cp.slot2 != NO_SLOT) circleCounts[cp.slot2]++;
+        groupedPairs.push_back(cp);
+    }
+    if( groupedPairs.empty() ) return false;
+    
+    auto flip = [](CirclePair& cp)
+    {
+        std::swap(cp.pair.e1, cp.pair.e2);
+        std::swap(cp.slot1, cp.slot2);
+        cp.flipped = !cp.flipped;
+    };
+    
+    // each pair goes to the body with the most circle pairs (a static body never leads)
+    for(auto& cp : groupedPairs)
+    {
+        if( cp.slot2 != NO_SLOT && (cp.slot1 == NO_SLOT || circleCounts[cp.slot2] > circleCounts[cp.slot1]) ) flip(cp);
+    }
+    
+    // then joins its other body when that one leads a group at least as big
+    for(auto& c : circleCounts) c = 0;
+    for(auto& cp : groupedPairs) circleCounts[cp.slot1]++;
+    for(auto& cp : groupedPairs)
+    {
+        if(cp.slot2 == NO_SLOT) continue;
+        unsigned& lead = circleCounts[cp.slot1];
+        unsigned& other = circleCounts[cp.slot2];
+        if(other >= lead)
+        {
+            lead--; other++;
+            flip(cp);
+        }
+    }
+    
+    // start of each group, in body order (stable : a group keeps the pair order)
+    unsigned others = groupedList.size();
+    groupedList.resize(pairs.size());
+    groupedIndex.resize(pairs.size());
+    groupedFlipped.resize(pairs.size());
+    for(auto& c : circleCounts) c = 0;
+    for(auto& cp : groupedPairs) circleCounts[cp.slot1+1]++;
+    for(unsigned i=1; i<=n; ++i) circleCounts[i] += circleCounts[i-1];
+    for(auto& cp : groupedPairs)
+    {
+        unsigned k = others + circleCounts[cp.slot1]++;
+        groupedList[k] = cp.pair;
+        groupedIndex[k] = cp.index;
+        groupedFlipped[k] = cp.flipped ? 1 : 0;
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------
+// collisions of the grouped pairs put back in the order of pairs (one collision per pair at most)
+void PhysicEngine::restorePairOrder(unsigned chunkCount)
+{
+    TraceScope scope(trace, "restore pair order");
+    
+    pairCollision.assign(pairs.size(), ~0u);
+    unsigned c = 0;
+    for(unsigned k=0; k<chunkCount; ++k)
+        for(auto i : chunks[k].pairIndex) pairCollision[i] = c++;
+    
+    restoredCollisions.clear();
+    for(auto i : pairCollision)
+        if(i != ~0u) restoredCollisions.push_back(collisions[i]);
+    std::swap(collisions, restoredCollisions);
+}
+
+// --------------------------------------------------------------------------
+const Arr<EntityPair>& PhysicEngine::testedPairs() const
+{
+    return pairsGrouped ? groupedList : pairs;
+}
+
+// --------------------------------------------------------------------------
+void PhysicEngine::narrowphaseRange(unsigned begin, unsigned end, NarrowphaseChunk& chunk) const
+{
+    TraceScope scope(trace, "narrowphase chunk");
+    chunk.clear();
+    
+    const Arr<EntityPair>& tested = testedPairs();
+    for(unsigned i=begin; i<end; )
+    {
+        const EntityPair& p = tested[i];
+        if(p.e1->shape == SHAPE_CIRCLE && p.e2->shape == SHAPE_CIRCLE)
+        {
+            i = collideCircles(i, end, chunk);
+            continue;
+        }
+        
+        // only circle pairs are flipped by the grouping
+        CollisionData res_coll;
+        chunk.tests++;
+        if( narrowphase(*p.e1,*p.e2,res_coll,chunk.axes,chunk.arena) )
+        {
+            chunk.collisions.push_back(res_coll);
+            chunk.pairIndex.push_back( pairsGrouped ? groupedIndex[i] : i );
+        }
+        chunk.arena.reset();
+        ++i;
+    }
+}
+
+// --------------------------------------------------------------------------
+// test the run of circle pairs in [first;last) which share the same e1 as one batch
+// (groupCirclePairs puts the candidates of a body together), return the end of the run
+// only runs filling a vector test are batched, shorter ones cost more to pack than they save
+// and are tested pair by pair
+// each pair is tested with the bodies order of its candidate pair, so collisions are the same
+// as with a pair by pair test
+unsigned PhysicEngine::collideCircles(unsigned first, unsigned last, NarrowphaseChunk& chunk) const
+{
+    const Arr<EntityPair>& tested = testedPairs();
+    Entity* e1 = tested[first].e1;
+    
+    unsigned end = first;
+    while(end < last && tested[end].e1 == e1 && tested[end].e2->shape == SHAPE_CIRCLE) ++end;
+    
+    chunk.circlePairs += end - first;
+    
+    auto pairIndex = [this](unsigned i) { return pairsGrouped ? groupedIndex[i] : i; };
+    auto flipped = [this](unsigned i) { return pairsGrouped && groupedFlipped[i] != 0; };
+    
+    unsigned width = circleBatchWidth(simdLevel);
+    if(width == 0 || end - first < width)
+    {
+        for(unsigned i=first; i<end; ++i)
+        {
+            Entity* e2 = tested[i].e2;
             CollisionData res_coll;
-            
-            if( Entity2Entity(*e1,*e2,res_coll) ) 
+            chunk.tests++;
+            bool hit = flipped(i) ? Entity2Entity(*e2,*e1,res_coll,chunk.arena) : Entity2Entity(*e1,*e2,res_coll,chunk.arena);
+            if(hit)
             {
-                collisions.push_back(res_coll);
-                pairs.push_back( p );
+                chunk.collisions.push_back(res_coll);
+                chunk.pairIndex.push_back( pairIndex(i) );
             }
+            chunk.arena.reset();
         }
+        return end;
     }
+    
+    chunk.circleBatch.clear();
+    for(unsigned i=first; i<end; ++i) chunk.circleBatch.add( static_cast<CircleEntity*>(tested[i].e2), pairIndex(i), flipped(i) );
+    
+    collideCircleBatch(static_cast<CircleEntity&>(*e1), chunk.circleBatch, chunk.collisions, chunk.pairIndex, chunk.tests, simdLevel);
+    chunk.batchedCirclePairs += end - first;
+    chunk.circleBatches++;
+    return end;
 }
 
 // --------------------------------------------------------------------------
-void PhysicEngine::resolveCollisions(float elapsedSec)
+bool PhysicEngine::narrowphase(Entity& e1, Entity& e2, CollisionData& res, AxisScratch& axes, ScratchArena& arena) const
 {
-    for(auto& coll : collisions)
-        resolveCollision(coll);
+    if(e1.shape == SHAPE_RECT && e2.shape == SHAPE_RECT)
+        return axisCache.collide(static_cast<RectEntity&>(e1), static_cast<RectEntity&>(e2), res, axes, arena);
+    
+    return Entity2Entity(e1, e2, res, arena);
 }
 
 // --------------------------------------------------------------------------
-void advance(Entity* e)
+void PhysicEngine::resolveCollisions(float)
 {
-    if(e->mass != 0.f)
+    if(solverMode == SOLVER_COLORED)
+    {
+        resolveColors();
+        contactCache.store(collisions);
+        return;
+    }
+    
+    {
+        TraceScope scope(trace, "islands");
+        islands.build(collisions, bodies);
+    }
+    stats.islands = islands.size();
+    stats.largestIsland = islands.size() ? islands.count(islands.order[0]) : 0;
+    
+    // islands share no moving body : solved in any order and on any thread, the result is
+    // the one of the serial contact order, biggest islands first so they do not end last
+    pool->parallelTasks(islands.size(), [this](unsigned i)
     {
-        e->position += e->v_linear;
-        e->rotation += e->v_angular;
+        resolveIsland(islands.order[i]);
+    });
     
-        if(e->v_linear.x > 0.0001) e->v_linear.x-=0.0001;
-        else if(e->v_linear.x < -0.0001) e->v_linear.x+=0.0001;
-        else e->v_linear.x=0.0;
+    contactCache.store(collisions);
+}
+
+// --------------------------------------------------------------------------
+void PhysicEngine::resolveIsland(unsigned k)
+{
+    for(unsigned i=islands.start[k]; i<islands.start[k+1]; ++i)
+        resolveCollision(collisions[ islands.contacts[i] ]);
+}
+
+// --------------------------------------------------------------------------
+void PhysicEngine::resolveColors()
+{
+    {
+        TraceScope scope(trace, "coloring");
+        coloring.build(collisions, bodies);
+    }
+    stats.contactColors = coloring.size();
+    
+    for(unsigned k=0; k<coloring.size(); ++k)
+    {
+        const unsigned* contacts = coloring.contacts.data() + coloring.start[k];
+        unsigned count = coloring.count(k);
+        
+        // contacts left without color may share bodies : one after the other
+        if(coloring.overflow && k+1 == coloring.size())
+        {
+            for(unsigned i=0; i<count; ++i) resolveCollision(collisions[ contacts[i] ]);
+            break;
+        }
         
-        if(e->v_angular > 0.001) e->v_angular-=0.001;
-        else if(e->v_angular < -0.001) e->v_angular+=0.001;
-        else e->v_angular=0.0;
+        // a color has no shared moving body : chunks run in parallel, each in vector lanes
+        unsigned chunkCount = (count + colorGrain - 1) / colorGrain;
+        if(colorLanes.size() < chunkCount) colorLanes.resize(chunkCount);
+        pool->parallelFor(count, colorGrain, [&](unsigned begin, unsigned end)
+        {
+            solveContactBatch(collisions, contacts + begin, end - begin, colorLanes[begin / colorGrain], simdLevel);
+        });
     }
+}
+
+// --------------------------------------------------------------------------
+void PhysicEngine::advanceTransformation(float)
+{
+    stats.integratedBodies = integrateMotion(bodies, simdLevel);
     
-    RectEntity* re = dynamic_cast<RectEntity*>(e);
-    if(re) { re->change(); re->update(); }
+    for(unsigned s=0; s<bodies.size(); ++s)
+        if(bodies.sleepGroup[s] == 0) updateShape(bodies.owner[s]);
+}
+
+// --------------------------------------------------------------------------
+// awake body moved by the solver
+bool movingBody(const Entity* e, const BodyStore& bodies)
+{
+    return e->store == &bodies && bodies.sleepGroup[e->bodySlot] == 0 && bodies.mass[e->bodySlot] != 0.f;
+}
+
+// --------------------------------------------------------------------------
+bool PhysicEngine::sleeping(const Entity* e) const
+{
+    return e->store == &bodies && bodies.sleepGroup[e->bodySlot] != 0;
+}
+
+// --------------------------------------------------------------------------
+void PhysicEngine::wake(Entity* e)
+{
+    if( sleeping(e) ) wakeRequests.push_back( bodies.sleepGroup[e->bodySlot] );
+}
+
+// --------------------------------------------------------------------------
+void PhysicEngine::applyWakes()
+{
+    std::sort(wakeRequests.begin(), wakeRequests.end());
+    wakeRequests.erase( std::unique(wakeRequests.begin(), wakeRequests.end()), wakeRequests.end() );
     
-    CircleEntity* ce = dynamic_cast<CircleEntity*>(e);
-    if(ce) { ce->center=ce->position; }
+    for(unsigned s=0; s<bodies.size(); ++s)
+    {
+        unsigned g = bodies.sleepGroup[s];
+        if( g == 0 || !std::binary_search(wakeRequests.begin(), wakeRequests.end(), g) ) continue;
+        
+        bodies.sleepGroup[s] = 0;
+        bodies.restTime[s] = 0.f;
+        sleepingCount--;
+        stats.wokenBodies++;
+    }
+    wakeRequests.clear();
 }
 
 // --------------------------------------------------------------------------
-void PhysicEngine::advanceTransformation(float elapsedSec)
+void PhysicEngine::wakePairs()
 {
-    for(auto& e : entities)
+    TraceScope scope(trace, "wake");
+    
+    // a woken island may touch another sleeping one : repeated until nothing wakes
+    bool woken = true;
+    while(woken)
     {
-        GroupEntity* ge = dynamic_cast<GroupEntity*>(e);
-        if(ge)
+        for(auto& p : pairs)
         {
-            for(auto& e2 : ge->entities) advance(e2);
+            if( movingBody(p.e1,bodies) && sleeping(p.e2) ) wake(p.e2);
+            else if( movingBody(p.e2,bodies) && sleeping(p.e1) ) wake(p.e1);
         }
-        else
+        woken = !wakeRequests.empty();
+        if(woken) applyWakes();
+    }
+    
+    // pairs left with a sleeping body are between bodies which do not move
+    unsigned n = 0;
+    for(auto& p : pairs)
+        if( !sleeping(p.e1) && !sleeping(p.e2) ) pairs[n++] = p;
+    pairs.resize(n);
+}
+
+// --------------------------------------------------------------------------
+void PhysicEngine::wakeAround(Entity* e)
+{
+    Arr<Entity*> leaves;
+    expandBodies(e, leaves);
+    for(auto& b : leaves)
+    {
+        AABB box;
+        if( !getBounds(*b, box) ) continue;
+        
+        for(unsigned s=0; s<bodies.size(); ++s)
         {
-            advance(e);
+            if(bodies.sleepGroup[s] == 0) continue;
+            
+            AABB other;
+            if( getBounds(*bodies.owner[s], other) && AABB2AABB(box, other) ) wakeRequests.push_back(bodies.sleepGroup[s]);
         }
     }
 }
+
+// --------------------------------------------------------------------------
+void PhysicEngine::updateSleep(float elapsedSec)
+{
+    if(!allowSleep) return;
+    TraceScope scope(trace, "sleep");
+    
+    // a body resting on another one goes up and down by the gravity of a step, and its velocity
+    // is cancelled by the penetration correction : the moves of the body are averaged over the
+    // last steps (weight of the last one) before the thresholds test
+    const float SMOOTHING = 0.0625f;
+    
+    // time spent under the thresholds (bodies without mass never move)
+    float linear2 = sleepLinear * sleepLinear;
+    for(unsigned s=0; s<bodies.size(); ++s)
+    {
+        if(bodies.sleepGroup[s] != 0) continue;
+        
+        Vec2 moved = bodies.position[s] - bodies.previousPosition[s];
+        float turned = bodies.rotation[s] - bodies.previousRotation[s];
+        bodies.meanLinear[s] += (moved - bodies.meanLinear[s]) * SMOOTHING;
+        bodies.meanAngular[s] += (turned - bodies.meanAngular[s]) * SMOOTHING;
+        
+        bool rest = bodies.mass[s] == 0.f
+            || ( len2(bodies.meanLinear[s]) <= linear2 && std::abs(bodies.meanAngular[s]) <= sleepAngular );
+        bodies.restTime[s] = rest ? bodies.restTime[s] + elapsedSec : 0.f;
+    }
+    
+    // only the jitter of a body at rest is dropped : a body sleeps after sleepDelay under the thresholds
+    auto sleepBody = [this](unsigned s, unsigned group)
+    {
+        bodies.sleepGroup[s] = group;
+        bodies.v_linear[s] = Vec2(0.f,0.f);
+        bodies.v_angular[s] = 0.f;
+        bodies.meanLinear[s] = Vec2(0.f,0.f);
+        bodies.meanAngular[s] = 0.f;
+        sleepingCount++;
+    };
+    auto newGroup = [this]()
+    {
+        unsigned g = nextSleepGroup++;
+        if(nextSleepGroup == 0) nextSleepGroup = 1;
+        return g;
+    };
+    
+    // islands of candidate pairs : overlapping bounds are steadier than contacts, which come
+    // and go on a resting pile (a body losing its contacts for one step would sleep alone)
+    sleepIslands.build(pairs, bodies);
+    
+    // an island sleeps as a whole, once its last moving body has rested long enough
+    for(unsigned k=0; k<sleepIslands.size(); ++k)
+    {
+        unsigned first = sleepIslands.bodyStart[k], last = sleepIslands.bodyStart[k+1];
+        if(first == last) continue;
+        
+        float rest = bodies.restTime[ sleepIslands.bodies[first] ];
+        for(unsigned i=first+1; i<last; ++i) rest = std::min(rest, bodies.restTime[ sleepIslands.bodies[i] ]);
+        if(rest < sleepDelay) continue;
+        
+        unsigned group = newGroup();
+        for(unsigned i=first; i<last; ++i) sleepBody(sleepIslands.bodies[i], group);
+    }
+    
+    // bodies overlapping nothing sleep alone
+    for(unsigned s=0; s<bodies.size(); ++s)
+    {
+        if(bodies.sleepGroup[s] != 0 || bodies.restTime[s] < sleepDelay) continue;
+        if(sleepIslands.islandOf(s) == ~0u) sleepBody(s, newGroup());
+    }
+}
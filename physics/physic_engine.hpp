@@ -2,8 +2,177 @@
 #define PHYSIC_ENGINE_HPP
 
 #include "physic_entity.hpp"
+#include "physic_broadphase.hpp"
+#include "physic_contactcache.hpp"
+#include "physic_integrate.hpp"
+#include "physic_circlebatch.hpp"
+#include "physic_profiler.hpp"
+#include "physic_island.hpp"
+#include "physic_colorsolver.hpp"
 
 
+// --------------------------------------------------------------------------
+// counters of the last update
+struct PhysicStats
+{
+    // candidate pairs rejected by collision filtering before the narrowphase
+    unsigned filteredPairs;
+    
+    // collisions warm started from a cached contact
+    unsigned warmStartedContacts;
+    
+    // rectangle pairs tested, and those rejected by their cached separating axis
+    unsigned rectPairTests;
+    unsigned separatingAxisHits;
+    
+    // circle/circle candidate pairs, those tested by the batch kernel, and batches they were packed in
+    unsigned circlePairs;
+    unsigned batchedCirclePairs;
+    unsigned circleBatches;
+    
+    // candidate pairs given to the narrowphase
+    unsigned candidatePairs;
+    
+    // exact shape tests run (circle pairs rejected by the batch distance test are not counted)
+    unsigned narrowphaseTests;
+    
+    // collisions found
+    unsigned contacts;
+    
+    // contact islands solved, and contacts of the largest one
+    unsigned islands;
+    unsigned largestIsland;
+    
+    // contact colors of the colored solver
+    unsigned contactColors;
+    
+    // bodies whose position has been advanced
+    unsigned integratedBodies;
+    
+    // bodies asleep at the end of the update, and sleeping bodies woken during it
+    unsigned sleepingBodies;
+    unsigned wokenBodies;
+    
+    // duration of each phase and of the whole update (milliseconds)
+    double phaseTime[PHASE_COUNT];
+    double stepTime;
+    
+    // part of the collect phase spent finding the candidate pairs (milliseconds)
+    double broadphaseTime;
+    
+    // part of the collect phase spent testing the candidate pairs, their sorting and grouping
+    // included (milliseconds)
+    double narrowphaseTime;
+    
+    // part of the rectangle pairs rejected by the axis cache [0;1]
+    float axisCacheHitRate() const;
+    
+    // mean circle pairs per batch
+    float circleBatchFill() const;
+    
+    PhysicStats();
+    
+    void reset();
+};
+
+// --------------------------------------------------------------------------
+// counters of the last stepFrame
+struct FrameStats
+{
+    // fixed steps run
+    unsigned steps;
+    
+    // steps due but not run : kept for the next frames, or dropped
+    unsigned deferredSteps;
+    unsigned droppedSteps;
+    
+    // true if the budget stopped the frame before its steps were done
+    bool overBudget;
+    
+    // wall time of the frame (milliseconds)
+    double time;
+    
+    FrameStats();
+    
+    void reset();
+};
+
+// --------------------------------------------------------------------------
+// circle pair and the slots of its bodies (~0 for a static body), grouped per body
+// index : position in the candidate pairs, flipped : bodies swapped from that pair
+struct CirclePair
+{
+    EntityPair pair;
+    unsigned slot1;
+    unsigned slot2;
+    unsigned index;
+    bool flipped;
+};
+
+// --------------------------------------------------------------------------
+// candidate pair and its stable sort key (deterministic mode)
+struct KeyedPair
+{
+    unsigned long long key;
+    EntityPair pair;
+};
+
+// --------------------------------------------------------------------------
+// results of a range of candidate pairs tested by one thread
+struct NarrowphaseChunk
+{
+    Arr<CollisionData> collisions;
+    
+    // index of the candidate pair of each collision
+    Arr<unsigned> pairIndex;
+    
+    // candidates of the circle being tested by the batch kernel
+    CircleBatch circleBatch;
+    
+    // separating axes found and axis cache counters
+    AxisScratch axes;
+    
+    // contact points of an exact test, reset after each test (results are copied out)
+    ScratchArena arena;
+    
+    // exact tests run, circle pairs (all, and given to the batch kernel) and batches run
+    unsigned tests;
+    unsigned circlePairs;
+    unsigned batchedCirclePairs;
+    unsigned circleBatches;
+    
+    NarrowphaseChunk();
+    
+    void clear();
+};
+
+// --------------------------------------------------------------------------
+// order in which the contacts are solved
+enum SolverMode
+{
+    // contact order inside independent islands (same result as a serial solver)
+    SOLVER_ISLANDS,
+    
+    // color by color, contacts of a color solved together with vector instructions
+    // (one pass per color, so the result differs from the contact order)
+    SOLVER_COLORED
+};
+
+// --------------------------------------------------------------------------
+// circle pairs grouped per body, so the runs filling a vector test go through the batch kernel
+// (the collisions are the same in every mode)
+enum CircleBatching
+{
+    // grouped while the grouped narrowphase is measured faster than the pair tests
+    BATCH_AUTO,
+    
+    // never grouped (a run of the candidate pairs filling a vector is still batched)
+    BATCH_OFF,
+    
+    // grouped at every step, to check the batch kernel
+    BATCH_ALWAYS
+};
+
 // --------------------------------------------------------------------------
 // Main interface for physic entity animating
 struct PhysicEngine
@@ -11,36 +180,238 @@ struct PhysicEngine
     // list of registered entitites
     Arr<Entity*> entities;
     
+    // registered entities which can move (not static)
+    Arr<Entity*> dynamicEntities;
+    
+    // physical state of the bodies of the dynamic entities
+    BodyStore bodies;
+    
+    // static entities (mass == 0), never integrated nor transformed
+    StaticGeometry staticGeometry;
+    
+    // physical state of the bodies of the static entities
+    BodyStore staticBodies;
+    
     // detected collision list
     Arr<CollisionData> collisions;
     
+    // candidate pairs finder and its last results
+    Broadphase* broadphase;
+    Arr<EntityPair> pairs;
+    
+    // contacts of the last steps, for warm starting
+    ContactCache contactCache;
+    
+    // separating axes of the previous step, for rectangle pairs
+    AxisCache axisCache;
+    
+    // contacts grouped by independent sets of bodies, for the solver
+    ContactIslands islands;
+    
+    // lockstep mode : pairs are oriented and sorted by a key made of body slots (static
+    // bodies by their static geometry index) before the narrowphase, so collisions reach the
+    // solver in an order which depends neither on the broadphase nor on memory addresses
+    // (the parallel phases already give the same result for any thread count, and the
+    // instruction set does not change it : circle pairs grouped for the vector batches are
+    // put back in the sorted order and orientation before the solver)
+    bool deterministic;
+    
+    // grouping of the circle pairs for the batch kernel (instruction sets with a vector test only)
+    CircleBatching circleBatching;
+    
+    // contact solver, and contacts split in colors for SOLVER_COLORED
+    SolverMode solverMode;
+    ContactColoring coloring;
+    
+    // contacts of a color per thread chunk, and per chunk vector lanes
+    unsigned colorGrain;
+    Arr<ContactLanes> colorLanes;
+    
+    // sleeping : bodies whose bounds overlap form islands, an island whose bodies all stayed under
+    // sleepLinear (pixels per step) and sleepAngular (degrees per step) during sleepDelay seconds
+    // is put to sleep (moves averaged over the last steps, a slowly moving body is not frozen). Sleeping
+    // bodies are neither integrated, transformed, tested against each other nor solved, they
+    // are woken with their island by a candidate pair with an awake body, by wake / applyImpulse,
+    // or when an entity overlapping them is removed
+    // off by default : once it is on, velocities written from outside the engine
+    // (e->v_linear() = ...) are ignored by a sleeping body unless followed by wake(e)
+    bool allowSleep;
+    float sleepDelay;
+    float sleepLinear;
+    float sleepAngular;
+    
+    // fixed step scheduler (stepFrame) : frame times are accumulated and consumed by steps of
+    // fixedStep seconds, so the motion does not depend on the frame rate (velocities are in
+    // pixels per step). A frame runs maxSubsteps steps at most, and after its first step starts
+    // no step expected to end after frameBudget milliseconds (0 : no budget). The steps left are
+    // kept for the next frames if deferSteps (never more than maxSubsteps), dropped otherwise
+    float fixedStep;
+    unsigned maxSubsteps;
+    double frameBudget;
+    bool deferSteps;
+    
+    // time not stepped yet, and its part of a step : draw at alpha between the 2 last steps
+    float accumulator;
+    float alpha;
+    
+    // threads running the narrowphase and the solver
+    ThreadPool* pool;
+    bool ownPool;
+    
+    // candidate pairs per narrowphase chunk, and per chunk results (merged in chunk order)
+    unsigned narrowphaseGrain;
+    Arr<NarrowphaseChunk> chunks;
+    
+    // counters of the last update, and of the last stepFrame
+    PhysicStats stats;
+    FrameStats frameStats;
+    
+    // instruction set of the integration kernels (best supported by default)
+    SimdLevel simdLevel;
+    
+    // notified around each phase of an update (optional, not owned)
+    PhysicProfiler* profiler;
+    
+    // receives the scoped events of the updates (optional, not owned)
+    PhysicTrace* trace;
+    
     // gravity direction and force
     Vec2 gravityVec;
     float gravityForce;
     
-    PhysicEngine();
+    // bp : pair finder, owned by the engine (sweep and prune if null)
+    // tp : shared threads (not owned), the engine runs on the calling thread only if null :
+    // the engines of a program may share a pool rather than have one each, if they are stepped
+    // one after another on the same thread (a pool runs one loop at a time, see ThreadPool)
+    PhysicEngine(Broadphase* bp = nullptr, ThreadPool* tp = nullptr);
     virtual ~PhysicEngine();
     
     // register an entity
+    // an entity whose bodies all have a null mass goes to the static geometry
     void addEntity(Entity* e);
     
+    // unregister an entity (not deleted)
+    void removeEntity(Entity* e);
+    
+    // dynamic entity of a body handle (null if destroyed or not in this engine)
+    Entity* getEntity(BodyHandle h) const;
+    
     // update all registered entities
     void updateEntities(float elapsedSec);
+    
+    // add the time of a frame and run the fixed steps due, return the number of steps run
+    unsigned stepFrame(float frameSec);
+    
+    // pose of the body of e at alpha between the 2 last steps of stepFrame
+    Vec2 interpolatedPosition(const Entity* e) const;
+    float interpolatedRotation(const Entity* e) const;
+    
+    // phase boundaries of an update (timing, trace, profiler)
+    void beginPhase(PhysicPhase phase);
+    void endPhase(PhysicPhase phase);
 
     // collisions detection and resolving
     void collectCollisions();
+    void sortPairs();
+    bool groupCirclePairs();
+    void restorePairOrder(unsigned chunkCount);
+    
+    // pairs in narrowphase order : the candidate pairs, or their grouped copy
+    const Arr<EntityPair>& testedPairs() const;
+    
+    // stable key of a body : slot of a dynamic body, static ones after all dynamic ones
+    unsigned bodyKey(const Entity* e) const;
+    
+    void narrowphaseRange(unsigned begin, unsigned end, NarrowphaseChunk& chunk) const;
+    unsigned collideCircles(unsigned first, unsigned last, NarrowphaseChunk& chunk) const;
+    bool narrowphase(Entity& e1, Entity& e2, CollisionData& res, AxisScratch& axes, ScratchArena& arena) const;
     void resolveCollision(CollisionData& collision);
     void resolveCollisions(float elapsedSec);
+    void resolveIsland(unsigned k);
+    void resolveColors();
     
     // cancel penetration distance between 2 entitties
     void resolvePenetration(CollisionData& mf);
 
     // apply gravity and collisions effects
     void applyGravity(float elapsedSec);
-    void applyResponse(Entity& e1, const Vec2& contact, const Vec2& normal2,Entity& e2);
+    
+    // apply the collision response on e1, as a correction of the normal impulse already applied
+    void applyResponse(Entity& e1, const Vec2& contact, const Vec2& normal2,Entity& e2, float& normalImpulse);
+    
+    // apply an impulse on e1 at contact point
+    void applyImpulse(Entity& e1, const Vec2& contact, const Vec2& impulse);
 
     // appply linear and angular velocities on position and rotation
     void advanceTransformation(float elapsedSec);
+    
+    // wake the island of a sleeping body (at the beginning of the next update)
+    // velocities changed from outside the engine must be followed by a wake
+    void wake(Entity* e);
+    
+    // true if the body of e is asleep
+    bool sleeping(const Entity* e) const;
+    
+    // rest time of the bodies, islands at rest for sleepDelay are put to sleep
+    void updateSleep(float elapsedSec);
+    
+protected:
+    // wake the islands of wakeRequests
+    void applyWakes();
+    
+    // wake the sleeping bodies touching the pairs of an awake body, until no island is woken,
+    // then drop the pairs without an awake body
+    void wakePairs();
+    
+    // wake the sleeping bodies whose bounds overlap the bodies of e
+    void wakeAround(Entity* e);
+    
+    // bodies grouped by candidate pairs, put to sleep together
+    ContactIslands sleepIslands;
+    
+    // sleeping islands to wake
+    Arr<unsigned> wakeRequests;
+    
+    // bodies asleep, and id of the next sleeping island (0 means awake)
+    unsigned sleepingCount;
+    unsigned nextSleepGroup;
+    
+    // sort buffer of sortPairs
+    Arr<KeyedPair> keyedPairs;
+    
+    // buffers of groupCirclePairs : circle pairs, and per body counters
+    Arr<CirclePair> groupedPairs;
+    Arr<unsigned> circleCounts;
+    
+    // the grouped narrowphase is the faster one (or is being tried), step in the tries period,
+    // and mean narrowphase time per candidate pair without and with grouping (milliseconds, 0 if not measured)
+    bool groupCircles;
+    unsigned circleProbe;
+    double pairCost;
+    double groupedCost;
+    
+    // grouping only builds the batches : the narrowphase tests a grouped copy of the pairs, each
+    // with its index in pairs and the bodies order of that pair, and restorePairOrder puts the
+    // collisions back in the order of pairs, so the solver sees the same collisions with or
+    // without grouping (whatever the instruction set)
+    bool pairsGrouped;
+    Arr<EntityPair> groupedList;
+    Arr<unsigned> groupedIndex;
+    Arr<unsigned char> groupedFlipped;
+    
+    // buffers of restorePairOrder : collision of each pair (~0 if none), collisions in pair order
+    Arr<unsigned> pairCollision;
+    Arr<CollisionData> restoredCollisions;
+    
+    // size the per step buffers for the dynamic bodies (with some headroom), so that the steps
+    // of a world whose contacts pile up do not allocate
+    void reserveBuffers();
+    
+    // dynamic bodies the per step buffers are sized for
+    unsigned reservedBodies;
+    
+    // clock value at the beginning of the current phase
+    unsigned long long phaseStart;
 };
 
 
@@ -3,25 +3,58 @@
 
 // --------------------------------------------------------------------------
 Entity::Entity(Vec2 p, float m, float r, float f)
-    : mass(m)
-    , friction(f)
-    , restitution(r)
-    , v_angular(0.0)
-    , position(p)
-    , rotation(0.0)
+    : store( &BodyStore::shared() )
+    , bodySlot( store->create(this,p,m,r,f) )
+    , shape(SHAPE_NONE)
+    , parent(nullptr)
+    , category(0x0001)
+    , mask(0xFFFFFFFF)
+    , filterGroup(0)
 {}
 
 // --------------------------------------------------------------------------
-Entity::~Entity() {}
+Entity::Entity(ShapeType s)
+    : store(nullptr)
+    , bodySlot(0)
+    , shape(s)
+    , parent(nullptr)
+    , category(0x0001)
+    , mask(0xFFFFFFFF)
+    , filterGroup(0)
+{}
+
+// --------------------------------------------------------------------------
+Entity::~Entity()
+{
+    if(store != nullptr) store->release(bodySlot);
+}
+
+// --------------------------------------------------------------------------
+BodyHandle Entity::handle() const
+{
+    if(store == nullptr) return BodyHandle();
+    return store->handle(bodySlot);
+}
+
 
 
 
+// --------------------------------------------------------------------------
+CollisionData::CollisionData()
+    : e1(nullptr)
+    , e2(nullptr)
+    , penetration(0.f)
+    , normalImpulse1(0.f)
+    , normalImpulse2(0.f)
+{}
 
 // --------------------------------------------------------------------------
 CircleEntity::CircleEntity(Vec2 p, float r, float m)
     : Entity(p,m)
     , Circle(p,r)
-{}
+{
+    shape = SHAPE_CIRCLE;
+}
 
 // --------------------------------------------------------------------------
 CircleEntity::~CircleEntity() {}
@@ -37,7 +70,9 @@ RectEntity::RectEntity(Vec2 p, float w,float h,float m)
     , height(h)
     , dirty(true)
     , baseModel(w,h)
-{}
+{
+    shape = SHAPE_RECT;
+}
 
 // --------------------------------------------------------------------------
 RectEntity::~RectEntity() {}
@@ -48,8 +83,8 @@ void RectEntity::update()
     if(dirty)
     {
         clone(baseModel);
-        rotate(rotation);
-        move(position);
+        rotate(rotation());
+        move(position());
         dirty = false;
     }
 }
@@ -60,7 +95,7 @@ void RectEntity::change() { dirty = true; }
 
 
 // --------------------------------------------------------------------------
-GroupEntity::GroupEntity() : Entity() {}
+GroupEntity::GroupEntity() : Entity(SHAPE_GROUP) {}
 
 // --------------------------------------------------------------------------
 GroupEntity::~GroupEntity() {}
@@ -68,6 +103,7 @@ GroupEntity::~GroupEntity() {}
 // --------------------------------------------------------------------------
 void GroupEntity::compose(Entity* e)
 {
+    e->parent = this;
     entities.push_back(e);
 }
 
@@ -96,15 +132,17 @@ Vec2 projectOnEdge(const RectEntity& r, const Vec2& p)
     float maxEdgeDist = len( Vec2(r.width,r.height) );
     Vec2 ray = normalize(p) * maxEdgeDist * (1.f+EPSILON);
     
-    Arr<Vec2> res_p, res_n;
-    Seg2Poly(r.position, r.position+ray, r, res_p, res_n);
+    // a segment crosses a rectangle at most twice
+    Vec2 points[4], normals[4];
+    VecBuffer res_p(points,4), res_n(normals,4);
+    Seg2Poly(r.position(), r.position()+ray, r, res_p, res_n);
     
     if(res_p.empty()) return normalize(p) * maxEdgeDist;
-    return res_p[0] - r.position;
+    return res_p[0] - r.position();
 }
 
 // --------------------------------------------------------------------------
-Vec2 averagePosition(const Arr<Vec2>& arr)
+Vec2 averagePosition(const VecBuffer& arr)
 {
     Vec2 res;
     for(auto v : arr) res += v;
@@ -112,7 +150,7 @@ Vec2 averagePosition(const Arr<Vec2>& arr)
 }
 
 // --------------------------------------------------------------------------
-Vec2 averageNormal(const Arr<Vec2>& arr)
+Vec2 averageNormal(const VecBuffer& arr)
 {
     Vec2 res;
     for(auto v : arr) res += v;
@@ -123,37 +161,110 @@ Vec2 averageNormal(const Arr<Vec2>& arr)
 
 
 // --------------------------------------------------------------------------
-bool Entity2Entity(const Entity& e1, const Entity& e2, CollisionData& out_coll)
+bool getBounds(const Entity& e, AABB& out_box)
 {
-    const RectEntity* r1 = dynamic_cast< const RectEntity* >( &e1 );
-    const RectEntity* r2 = dynamic_cast< const RectEntity* >( &e2 );
-    const CircleEntity* c1 = dynamic_cast< const CircleEntity* >( &e1 );
-    const CircleEntity* c2 = dynamic_cast< const CircleEntity* >( &e2 );
-    // GroupEntity* g1 = dynamic_cast< const GroupEntity* >(&e1);
-    const GroupEntity* g2 = dynamic_cast< const GroupEntity* >(&e2);
-    
-    if(g2)
+    switch(e.shape)
     {
-        for(auto& e2bis : g2->entities) 
-        {
-            if(e1.mass == 0.f && e2bis->mass == 0.f) continue;
-            if( Entity2Entity(e1,*e2bis,out_coll) ) return true;
-        }
-        return false;
+        case SHAPE_RECT : out_box = static_cast<const RectEntity&>(e).bounds(); return true;
+        case SHAPE_CIRCLE : out_box = static_cast<const CircleEntity&>(e).bounds(); return true;
+        default : return false;
+    }
+}
+
+
+
+// --------------------------------------------------------------------------
+bool shouldCollide(const Entity& e1, const Entity& e2)
+{
+    if(e1.filterGroup != 0 && e1.filterGroup == e2.filterGroup) return e1.filterGroup > 0;
+    return (e1.category & e2.mask) != 0 && (e2.category & e1.mask) != 0;
+}
+
+
+
+// --------------------------------------------------------------------------
+// adapt a typed collision test to the dispatch table
+template<typename T1, typename T2, bool (*Func)(const T1&, const T2&, CollisionData&, ScratchArena&)>
+bool collideAs(const Entity& e1, const Entity& e2, CollisionData& res, ScratchArena& scratch)
+{
+    return Func( static_cast<const T1&>(e1), static_cast<const T2&>(e2), res, scratch );
+}
+
+// --------------------------------------------------------------------------
+// same with swapped arguments (the result keeps the order of Func)
+template<typename T1, typename T2, bool (*Func)(const T1&, const T2&, CollisionData&, ScratchArena&)>
+bool collideSwapped(const Entity& e1, const Entity& e2, CollisionData& res, ScratchArena& scratch)
+{
+    return Func( static_cast<const T1&>(e2), static_cast<const T2&>(e1), res, scratch );
+}
+
+// --------------------------------------------------------------------------
+// circles need no temporary points
+bool collideCircles(const CircleEntity& c1, const CircleEntity& c2, CollisionData& res, ScratchArena&)
+{
+    return Circle2Circle(c1, c2, res);
+}
+
+// --------------------------------------------------------------------------
+// e2 is a group : first colliding child
+bool collideGroup(const Entity& e1, const Entity& e2, CollisionData& res, ScratchArena& scratch)
+{
+    for(auto& e2bis : static_cast<const GroupEntity&>(e2).entities)
+    {
+        if( Entity2Entity(e1,*e2bis,res,scratch) ) return true;
     }
-    
-    if(e1.mass == 0.f && e2.mass == 0.f) return false;
-    if( r1 && r2 && Rect2Rect(*r1, *r2, out_coll) ) return true;
-    if( c1 && c2 && Circle2Circle(*c1, *c2, out_coll) ) return true;
-    if( c1 && r2 && Circle2Rect(*c1, *r2, out_coll) ) return true;
-    
     return false;
 }
 
+// --------------------------------------------------------------------------
+bool collideGroupSwapped(const Entity& e1, const Entity& e2, CollisionData& res, ScratchArena& scratch)
+{
+    return collideGroup(e2, e1, res, scratch);
+}
+
+// --------------------------------------------------------------------------
+// [type of e1][type of e2]
+static constexpr CollideFunc collideTable[SHAPE_COUNT][SHAPE_COUNT] =
+{
+    // SHAPE_NONE
+    { nullptr, nullptr, nullptr, nullptr },
+    // SHAPE_CIRCLE
+    {
+        nullptr,
+        collideAs<CircleEntity, CircleEntity, collideCircles>,
+        collideAs<CircleEntity, RectEntity, Circle2Rect>,
+        collideGroup
+    },
+    // SHAPE_RECT
+    {
+        nullptr,
+        collideSwapped<CircleEntity, RectEntity, Circle2Rect>,
+        collideAs<RectEntity, RectEntity, Rect2Rect>,
+        collideGroup
+    },
+    // SHAPE_GROUP
+    { nullptr, collideGroupSwapped, collideGroupSwapped, collideGroup }
+};
+
+// --------------------------------------------------------------------------
+CollideFunc getCollideFunc(ShapeType t1, ShapeType t2)
+{
+    return collideTable[t1][t2];
+}
+
+// --------------------------------------------------------------------------
+bool Entity2Entity(const Entity& e1, const Entity& e2, CollisionData& out_coll, ScratchArena& scratch)
+{
+    if(e1.shape != SHAPE_GROUP && e2.shape != SHAPE_GROUP && e1.mass() == 0.f && e2.mass() == 0.f) return false;
+    
+    CollideFunc func = collideTable[e1.shape][e2.shape];
+    return func != nullptr && func(e1, e2, out_coll, scratch);
+}
+
 // --------------------------------------------------------------------------
 bool Circle2Circle(const CircleEntity& c1, const CircleEntity& c2, CollisionData& res)
 {
-    Vec2 dir = c2.position - c1.position;
+    Vec2 dir = c2.position() - c1.position();
     float d = len(dir);
     float th = c1.radius+c2.radius;
     float penetration = th - d;
@@ -164,7 +275,7 @@ bool Circle2Circle(const CircleEntity& c1, const CircleEntity& c2, CollisionData
         res.penetration = penetration;
         res.normal1 = normalize( dir );
         res.normal2 = -res.normal1;
-        res.hitPoint = (c1.position + c2.position) * 0.5f;
+        res.hitPoint = (c1.position() + c2.position()) * 0.5f;
         return true;
     }
     
@@ -172,11 +283,12 @@ bool Circle2Circle(const CircleEntity& c1, const CircleEntity& c2, CollisionData
 }
 
 // --------------------------------------------------------------------------
-bool Rect2Rect(const RectEntity& r1, const RectEntity& r2, CollisionData& res)
+bool Rect2Rect(const RectEntity& r1, const RectEntity& r2, CollisionData& res, ScratchArena& scratch)
 {
-    Arr<Vec2> res_p;
-    Arr<Vec2> res_n1;
-    Arr<Vec2> res_n2;
+    unsigned cap = poly2PolyCapacity(r1.vertices.size(), r2.vertices.size());
+    VecBuffer res_p(scratch, cap);
+    VecBuffer res_n1(scratch, cap);
+    VecBuffer res_n2(scratch, cap);
     
     if( Poly2Poly(r1, r2, res_p, res_n1, res_n2) )
     {
@@ -185,16 +297,16 @@ bool Rect2Rect(const RectEntity& r1, const RectEntity& r2, CollisionData& res)
         Vec2 hitPoint = averagePosition(res_p);
         Vec2 n1,n2;
         if(!res_n1.empty()) n1 = averageNormal(res_n1);
-        else n1 = normalize(hitPoint - r1.position);
+        else n1 = normalize(hitPoint - r1.position());
         if(!res_n2.empty()) n2 = averageNormal(res_n2);
-        else n2 = normalize(hitPoint - r2.position);
+        else n2 = normalize(hitPoint - r2.position());
         // Vec2 n1 = averageNormal(res_n1);
         // Vec2 n2 = averageNormal(res_n2);
         
         res.e1 = const_cast<RectEntity*>( &r1 );
         res.e2 = const_cast<RectEntity*>( &r2 );
-        Vec2 r1k = hitPoint - r1.position;
-        Vec2 r2k = hitPoint - r2.position;
+        Vec2 r1k = hitPoint - r1.position();
+        Vec2 r2k = hitPoint - r2.position();
         
         Vec2 r1Edge = projectOnEdge(r1,r1k);
         Vec2 r2Edge = projectOnEdge(r2,r2k);
@@ -212,9 +324,45 @@ bool Rect2Rect(const RectEntity& r1, const RectEntity& r2, CollisionData& res)
 }
 
 // --------------------------------------------------------------------------
-bool Circle2Rect(const CircleEntity& c, const RectEntity& r, CollisionData& res)
+// a small circle may cross an edge within a step and be found with its center inside the
+// rectangle, no edge cut : it is pushed out through the nearest edge
+bool circleInsideRect(const CircleEntity& c, const RectEntity& r, CollisionData& res)
 {
-    Arr<Vec2> colli_p, colli_n;
+    const Vec2& center = c.position();
+    if( !inside(center, r) ) return false;
+    
+    // outward normal and depth of the nearest edge
+    Vec2 normal;
+    float depth = 0.f;
+    bool first = true;
+    Vec2 prev = r.vertices[r.vertices.size()-1];
+    for(auto ve : r.vertices)
+    {
+        Vec2 n = getNormal(prev,ve);
+        float d = dot(ve - center, n);
+        if(first || d < depth)
+        {
+            normal = n;
+            depth = d;
+            first = false;
+        }
+        prev = ve;
+    }
+    
+    res.e1 = const_cast<CircleEntity*>( &c );
+    res.e2 = const_cast<RectEntity*>( &r );
+    res.penetration = depth + c.radius;
+    res.normal1 = -normal;
+    res.normal2 = normal;
+    res.hitPoint = center + normal * depth;
+    return true;
+}
+
+// --------------------------------------------------------------------------
+bool Circle2Rect(const CircleEntity& c, const RectEntity& r, CollisionData& res, ScratchArena& scratch)
+{
+    VecBuffer colli_p(scratch, circle2PolyCapacity(r.vertices.size()));
+    VecBuffer colli_n(scratch, r.vertices.size());
     if( Circle2Poly(c, r, colli_p, colli_n) )
     {
         if(colli_p.empty()) return false;
@@ -222,10 +370,10 @@ bool Circle2Rect(const CircleEntity& c, const RectEntity& r, CollisionData& res)
         Vec2 hitPoint = averagePosition(colli_p);
         Vec2 r_normal;
         if(!colli_n.empty()) r_normal = averageNormal(colli_n);
-        else r_normal = normalize(r.position - c.position);
+        else r_normal = normalize(r.position() - c.position());
         
-        Vec2 ck = hitPoint - c.position;
-        Vec2 rk = hitPoint - r.position;
+        Vec2 ck = hitPoint - c.position();
+        Vec2 rk = hitPoint - r.position();
         
         Vec2 c_normal = normalize(ck);
         Vec2 rectEdge = projectOnEdge(r, rk);
@@ -240,5 +388,5 @@ bool Circle2Rect(const CircleEntity& c, const RectEntity& r, CollisionData& res)
         res.hitPoint = hitPoint;
         return true;
     }
-    return false;
+    return circleInsideRect(c, r, res);
 }
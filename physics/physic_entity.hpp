@@ -2,28 +2,72 @@
 #define PHYSIC_ENTITY_HPP
 
 #include "../maths/math_geometry.hpp"
+#include "../maths/math_scratch.hpp"
+#include "physic_body.hpp"
 
+struct GroupEntity;
+
+// --------------------------------------------------------------------------
+// concrete type of an entity, used for dispatching without RTTI
+enum ShapeType
+{
+    SHAPE_NONE,
+    SHAPE_CIRCLE,
+    SHAPE_RECT,
+    SHAPE_GROUP,
+    
+    SHAPE_COUNT
+};
 
 // --------------------------------------------------------------------------
 // physical entity
+// the physical state lives in a BodyStore (the one of its engine once registered),
+// the entity gives access to its slot
 struct Entity
 {
+    // store and slot of the physical state (no store for groups : the state is in their children)
+    BodyStore* store;
+    unsigned bodySlot;
+    
     // weight of the entity
-    float mass;
+    float& mass();
+    float mass() const;
     
     // resistance on surface [0;+1]
-    float friction;
+    float& friction();
+    float friction() const;
     
     // bouncing effect (generally between 0.2 and 0.8)
-    float restitution;
+    float& restitution();
+    float restitution() const;
     
     // velocities
-    float v_angular;
-    Vec2 v_linear;
+    float& v_angular();
+    float v_angular() const;
+    Vec2& v_linear();
+    const Vec2& v_linear() const;
     
     // current position and orientation in the world
-    Vec2 position;
-    float rotation;
+    Vec2& position();
+    const Vec2& position() const;
+    float& rotation();
+    float rotation() const;
+    
+    // stable reference to the body (changes when the entity is registered, the previous one is then stale)
+    BodyHandle handle() const;
+    
+    // concrete type (set by the derived constructors)
+    ShapeType shape;
+    
+    // owning group (null if the entity is registered alone)
+    GroupEntity* parent;
+    
+    // collision filtering : 2 bodies collide if each category matches the mask of the other
+    unsigned category;
+    unsigned mask;
+    
+    // bodies sharing a non-zero filter group always collide (positive) or never (negative)
+    int filterGroup;
     
     // construtor
     // p : position
@@ -31,7 +75,12 @@ struct Entity
     // r : restitution
     // f = friction
     Entity(Vec2 p = Vec2(0.f,0.f), float m = 1.f, float r = 0.5, float f = 0.4);
+    Entity(const Entity&) = delete;
     virtual ~Entity();
+
+protected:
+    // entity without physical state
+    Entity(ShapeType s);
 };
 
 // --------------------------------------------------------------------------
@@ -48,6 +97,14 @@ struct CollisionData
     Vec2 hitPoint;
     Vec2 normal1;
     Vec2 normal2;
+    
+    // normal impulses applied on e1 along normal2 and on e2 along normal1, without the
+    // restitution (warm start value, then corrected by the solver, never negative)
+    float normalImpulse1;
+    float normalImpulse2;
+    
+    // no impulse yet
+    CollisionData();
 };
 
 // --------------------------------------------------------------------------
@@ -118,8 +175,24 @@ struct BoxEntity : public GroupEntity
 };
 
 // --------------------------------------------------------------------------
-// generic collision test between 2 entities
-bool Entity2Entity(const Entity& e1, const Entity& e2, CollisionData& res);
+// compute the world bounding box of a collidable entity (false for groups)
+bool getBounds(const Entity& e, AABB& out_box);
+
+// --------------------------------------------------------------------------
+// test collision filtering (categories, masks and filter groups)
+bool shouldCollide(const Entity& e1, const Entity& e2);
+
+// --------------------------------------------------------------------------
+// generic collision test between 2 entities (dispatched on their shape types)
+// the temporary contact points are taken from scratch, the caller resets it
+bool Entity2Entity(const Entity& e1, const Entity& e2, CollisionData& res, ScratchArena& scratch);
+
+// --------------------------------------------------------------------------
+// collision test between 2 entities of known shape types
+using CollideFunc = bool (*)(const Entity& e1, const Entity& e2, CollisionData& res, ScratchArena& scratch);
+
+// function handling a pair of shape types
+CollideFunc getCollideFunc(ShapeType t1, ShapeType t2);
 
 // --------------------------------------------------------------------------
 // test collision between 2 circles
@@ -127,11 +200,34 @@ bool Circle2Circle(const CircleEntity& c1, const CircleEntity& c2, CollisionData
 
 // --------------------------------------------------------------------------
 // test collision between 2 rectangles
-bool Rect2Rect(const RectEntity& r1, const RectEntity& r2, CollisionData& res);
+bool Rect2Rect(const RectEntity& r1, const RectEntity& r2, CollisionData& res, ScratchArena& scratch);
 
 // --------------------------------------------------------------------------
 // test collision between a circle and a rectangle
-bool Circle2Rect(const CircleEntity& c, const RectEntity& r, CollisionData& res);
+bool Circle2Rect(const CircleEntity& c, const RectEntity& r, CollisionData& res, ScratchArena& scratch);
+
+// --------------------------------------------------------------------------
+// point of the rectangle edge in direction p (relative to its position)
+Vec2 projectOnEdge(const RectEntity& r, const Vec2& p);
+
+
+
+// --------------------------------------------------------------------------
+// Entity accessors are inlined : they are used by every physics stage
+inline float& Entity::mass() { return store->mass[bodySlot]; }
+inline float Entity::mass() const { return store->mass[bodySlot]; }
+inline float& Entity::friction() { return store->friction[bodySlot]; }
+inline float Entity::friction() const { return store->friction[bodySlot]; }
+inline float& Entity::restitution() { return store->restitution[bodySlot]; }
+inline float Entity::restitution() const { return store->restitution[bodySlot]; }
+inline float& Entity::v_angular() { return store->v_angular[bodySlot]; }
+inline float Entity::v_angular() const { return store->v_angular[bodySlot]; }
+inline Vec2& Entity::v_linear() { return store->v_linear[bodySlot]; }
+inline const Vec2& Entity::v_linear() const { return store->v_linear[bodySlot]; }
+inline Vec2& Entity::position() { return store->position[bodySlot]; }
+inline const Vec2& Entity::position() const { return store->position[bodySlot]; }
+inline float& Entity::rotation() { return store->rotation[bodySlot]; }
+inline float Entity::rotation() const { return store->rotation[bodySlot]; }
 
 
 #endif // PHYSIC_ENTITY_HPP
@@ -0,0 +1,335 @@
+#include "physic_integrate.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define PHYSIC_X86
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+#endif
+
+#if defined(__GNUC__)
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define TARGET_AVX2
+#endif
+
+static_assert( sizeof(Vec2) == 2*sizeof(float), "Vec2 arrays are read as float arrays" );
+
+// damping steps (double, as in the original scalar code)
+#define LINEAR_DAMPING 0.0001
+#define ANGULAR_DAMPING 0.001
+
+// --------------------------------------------------------------------------
+SimdLevel detectSimdLevel()
+{
+#if defined(PHYSIC_X86)
+    #if defined(__GNUC__)
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports("avx2") ) return SIMD_AVX2;
+        if( __builtin_cpu_supports("sse2") ) return SIMD_SSE2;
+    #elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1<<27)) != 0;
+        bool avx = (info[2] & (1<<28)) != 0;
+        bool sse2 = (info[3] & (1<<26)) != 0;
+        if(maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+        {
+            __cpuidex(info, 7, 0);
+            if(info[1] & (1<<5)) return SIMD_AVX2;
+        }
+        if(sse2) return SIMD_SSE2;
+    #endif
+#endif
+    return SIMD_SCALAR;
+}
+
+// --------------------------------------------------------------------------
+const char* simdLevelName(SimdLevel level)
+{
+    switch(level)
+    {
+        case SIMD_AVX2 : return "avx2";
+        case SIMD_SSE2 : return "sse2";
+        default : return "scalar";
+    }
+}
+
+
+
+// --------------------------------------------------------------------------
+void gravityScalar(BodyStore& bodies, const Vec2& dv, unsigned begin, unsigned end)
+{
+    for(unsigned i=begin; i<end; ++i)
+    {
+        if(bodies.mass[i] != 0.f && bodies.sleepGroup[i] == 0) bodies.v_linear[i] += dv;
+    }
+}
+
+// --------------------------------------------------------------------------
+unsigned motionScalar(BodyStore& bodies, unsigned begin, unsigned end)
+{
+    unsigned count = 0;
+    for(unsigned i=begin; i<end; ++i)
+    {
+        if(bodies.mass[i] == 0.f || bodies.sleepGroup[i] != 0) continue;
+        count++;
+
+        Vec2& v_linear = bodies.v_linear[i];
+        float& v_angular = bodies.v_angular[i];
+        bodies.position[i] += v_linear;
+        bodies.rotation[i] += v_angular;
+
+        if(v_linear.x > LINEAR_DAMPING) v_linear.x-=LINEAR_DAMPING;
+        else if(v_linear.x < -LINEAR_DAMPING) v_linear.x+=LINEAR_DAMPING;
+        else v_linear.x=0.0;
+
+        if(v_angular > ANGULAR_DAMPING) v_angular-=ANGULAR_DAMPING;
+        else if(v_angular < -ANGULAR_DAMPING) v_angular+=ANGULAR_DAMPING;
+        else v_angular=0.0;
+    }
+    return count;
+}
+
+
+
+#if defined(PHYSIC_X86)
+
+// --------------------------------------------------------------------------
+// number of set bits of a movemask result
+inline unsigned bitCount(int mask)
+{
+    unsigned count = 0;
+    for(; mask; mask &= mask-1) count++;
+    return count;
+}
+
+// --------------------------------------------------------------------------
+// select b where mask is set, else a
+inline __m128 select4(__m128 a, __m128 b, __m128 mask)
+{
+    return _mm_or_ps( _mm_and_ps(mask,b), _mm_andnot_ps(mask,a) );
+}
+
+// --------------------------------------------------------------------------
+// lanes of the bodies which move : mass not null and awake
+inline __m128 moving4(const float* m, const unsigned* sleep)
+{
+    __m128i awake = _mm_cmpeq_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>(sleep) ), _mm_setzero_si128() );
+    return _mm_and_ps( _mm_cmpneq_ps(_mm_loadu_ps(m), _mm_setzero_ps()), _mm_castsi128_ps(awake) );
+}
+
+// --------------------------------------------------------------------------
+// same for 2 bodies, in the low half
+inline __m128 moving2(const float* m, const unsigned* sleep)
+{
+    __m128 m2 = _mm_castpd_ps( _mm_load_sd( reinterpret_cast<const double*>(m) ) );
+    __m128i awake = _mm_cmpeq_epi32( _mm_loadl_epi64( reinterpret_cast<const __m128i*>(sleep) ), _mm_setzero_si128() );
+    return _mm_and_ps( _mm_cmpneq_ps(m2, _mm_setzero_ps()), _mm_castsi128_ps(awake) );
+}
+
+// --------------------------------------------------------------------------
+// v > step ? v-step : (v < -step ? v+step : 0), in double like the scalar code
+inline __m128d damp2(__m128d v, __m128d step)
+{
+    __m128d over = _mm_cmpgt_pd(v, step);
+    __m128d under = _mm_cmplt_pd(v, _mm_sub_pd(_mm_setzero_pd(),step));
+    return _mm_or_pd( _mm_and_pd(over, _mm_sub_pd(v,step)), _mm_and_pd(under, _mm_add_pd(v,step)) );
+}
+
+// --------------------------------------------------------------------------
+inline __m128 damp4(__m128 v, __m128d step)
+{
+    __m128d lo = damp2( _mm_cvtps_pd(v), step );
+    __m128d hi = damp2( _mm_cvtps_pd(_mm_movehl_ps(v,v)), step );
+    return _mm_movelh_ps( _mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi) );
+}
+
+// --------------------------------------------------------------------------
+// 2 bodies per vector
+void gravitySSE2(BodyStore& bodies, const Vec2& dv)
+{
+    unsigned n = bodies.size();
+    float* v = reinterpret_cast<float*>( bodies.v_linear.data() );
+    const float* m = bodies.mass.data();
+    const unsigned* s = bodies.sleepGroup.data();
+    __m128 dv4 = _mm_setr_ps(dv.x, dv.y, dv.x, dv.y);
+
+    unsigned i = 0;
+    for(; i+2<=n; i+=2)
+    {
+        __m128 m2 = moving2(m+i, s+i);
+        __m128 mask = _mm_unpacklo_ps(m2,m2);
+        __m128 v4 = _mm_loadu_ps(v + 2*i);
+        _mm_storeu_ps( v + 2*i, select4(v4, _mm_add_ps(v4,dv4), mask) );
+    }
+    gravityScalar(bodies, dv, i, n);
+}
+
+// --------------------------------------------------------------------------
+// 4 bodies per iteration
+unsigned motionSSE2(BodyStore& bodies)
+{
+    unsigned n = bodies.size();
+    float* p = reinterpret_cast<float*>( bodies.position.data() );
+    float* v = reinterpret_cast<float*>( bodies.v_linear.data() );
+    float* r = bodies.rotation.data();
+    float* w = bodies.v_angular.data();
+    const float* m = bodies.mass.data();
+    const unsigned* s = bodies.sleepGroup.data();
+    __m128d linearStep = _mm_set1_pd(LINEAR_DAMPING);
+    __m128d angularStep = _mm_set1_pd(ANGULAR_DAMPING);
+
+    unsigned count = 0;
+    unsigned i = 0;
+    for(; i+4<=n; i+=4)
+    {
+        __m128 mask = moving4(m+i, s+i);
+        count += bitCount( _mm_movemask_ps(mask) );
+        __m128 mask01 = _mm_unpacklo_ps(mask,mask);
+        __m128 mask23 = _mm_unpackhi_ps(mask,mask);
+
+        // rotation and angular damping
+        __m128 w4 = _mm_loadu_ps(w+i);
+        __m128 r4 = _mm_loadu_ps(r+i);
+        _mm_storeu_ps( r+i, select4(r4, _mm_add_ps(r4,w4), mask) );
+        _mm_storeu_ps( w+i, select4(w4, damp4(w4,angularStep), mask) );
+
+        // position : [x0 y0 x1 y1] [x2 y2 x3 y3]
+        __m128 v01 = _mm_loadu_ps(v + 2*i);
+        __m128 v23 = _mm_loadu_ps(v + 2*i + 4);
+        __m128 p01 = _mm_loadu_ps(p + 2*i);
+        __m128 p23 = _mm_loadu_ps(p + 2*i + 4);
+        _mm_storeu_ps( p + 2*i, select4(p01, _mm_add_ps(p01,v01), mask01) );
+        _mm_storeu_ps( p + 2*i + 4, select4(p23, _mm_add_ps(p23,v23), mask23) );
+
+        // linear damping on x only
+        __m128 xs = _mm_shuffle_ps(v01, v23, _MM_SHUFFLE(2,0,2,0));
+        __m128 ys = _mm_shuffle_ps(v01, v23, _MM_SHUFFLE(3,1,3,1));
+        xs = damp4(xs, linearStep);
+        _mm_storeu_ps( v + 2*i, select4(v01, _mm_unpacklo_ps(xs,ys), mask01) );
+        _mm_storeu_ps( v + 2*i + 4, select4(v23, _mm_unpackhi_ps(xs,ys), mask23) );
+    }
+    return count + motionScalar(bodies, i, n);
+}
+
+// --------------------------------------------------------------------------
+TARGET_AVX2 inline __m256d damp4d(__m256d v, __m256d step)
+{
+    __m256d over = _mm256_cmp_pd(v, step, _CMP_GT_OQ);
+    __m256d under = _mm256_cmp_pd(v, _mm256_sub_pd(_mm256_setzero_pd(),step), _CMP_LT_OQ);
+    return _mm256_or_pd( _mm256_and_pd(over, _mm256_sub_pd(v,step)), _mm256_and_pd(under, _mm256_add_pd(v,step)) );
+}
+
+// --------------------------------------------------------------------------
+TARGET_AVX2 inline __m256 damp8(__m256 v, __m256d step)
+{
+    __m256d lo = damp4d( _mm256_cvtps_pd(_mm256_castps256_ps128(v)), step );
+    __m256d hi = damp4d( _mm256_cvtps_pd(_mm256_extractf128_ps(v,1)), step );
+    return _mm256_insertf128_ps( _mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1 );
+}
+
+// --------------------------------------------------------------------------
+// [m0 m1 m2 m3] -> [m0 m0 m1 m1 m2 m2 m3 m3]
+TARGET_AVX2 inline __m256 duplicate4(__m128 m)
+{
+    __m128 lo = _mm_unpacklo_ps(m,m);
+    __m128 hi = _mm_unpackhi_ps(m,m);
+    return _mm256_insertf128_ps( _mm256_castps128_ps256(lo), hi, 1 );
+}
+
+// --------------------------------------------------------------------------
+// 4 bodies per vector
+TARGET_AVX2 void gravityAVX2(BodyStore& bodies, const Vec2& dv)
+{
+    unsigned n = bodies.size();
+    float* v = reinterpret_cast<float*>( bodies.v_linear.data() );
+    const float* m = bodies.mass.data();
+    const unsigned* s = bodies.sleepGroup.data();
+    __m256 dv8 = _mm256_setr_ps(dv.x, dv.y, dv.x, dv.y, dv.x, dv.y, dv.x, dv.y);
+
+    unsigned i = 0;
+    for(; i+4<=n; i+=4)
+    {
+        __m256 mask = duplicate4( moving4(m+i, s+i) );
+        __m256 v8 = _mm256_loadu_ps(v + 2*i);
+        _mm256_storeu_ps( v + 2*i, _mm256_blendv_ps(v8, _mm256_add_ps(v8,dv8), mask) );
+    }
+    gravityScalar(bodies, dv, i, n);
+}
+
+// --------------------------------------------------------------------------
+// 8 bodies per iteration
+TARGET_AVX2 unsigned motionAVX2(BodyStore& bodies)
+{
+    unsigned n = bodies.size();
+    float* p = reinterpret_cast<float*>( bodies.position.data() );
+    float* v = reinterpret_cast<float*>( bodies.v_linear.data() );
+    float* r = bodies.rotation.data();
+    float* w = bodies.v_angular.data();
+    const float* m = bodies.mass.data();
+    const unsigned* s = bodies.sleepGroup.data();
+    __m256 zero = _mm256_setzero_ps();
+    __m256d linearStep = _mm256_set1_pd(LINEAR_DAMPING);
+    __m256d angularStep = _mm256_set1_pd(ANGULAR_DAMPING);
+
+    unsigned count = 0;
+    unsigned i = 0;
+    for(; i+8<=n; i+=8)
+    {
+        __m256i awake = _mm256_cmpeq_epi32( _mm256_loadu_si256( reinterpret_cast<const __m256i*>(s+i) ), _mm256_setzero_si256() );
+        __m256 mask = _mm256_and_ps( _mm256_cmp_ps( _mm256_loadu_ps(m+i), zero, _CMP_NEQ_UQ ), _mm256_castsi256_ps(awake) );
+        count += bitCount( _mm256_movemask_ps(mask) );
+        __m256 mask0 = duplicate4( _mm256_castps256_ps128(mask) );
+        __m256 mask1 = duplicate4( _mm256_extractf128_ps(mask,1) );
+
+        // rotation and angular damping
+        __m256 w8 = _mm256_loadu_ps(w+i);
+        __m256 r8 = _mm256_loadu_ps(r+i);
+        _mm256_storeu_ps( r+i, _mm256_blendv_ps(r8, _mm256_add_ps(r8,w8), mask) );
+        _mm256_storeu_ps( w+i, _mm256_blendv_ps(w8, damp8(w8,angularStep), mask) );
+
+        // position : bodies 0-3 and 4-7
+        __m256 v0 = _mm256_loadu_ps(v + 2*i);
+        __m256 v1 = _mm256_loadu_ps(v + 2*i + 8);
+        __m256 p0 = _mm256_loadu_ps(p + 2*i);
+        __m256 p1 = _mm256_loadu_ps(p + 2*i + 8);
+        _mm256_storeu_ps( p + 2*i, _mm256_blendv_ps(p0, _mm256_add_ps(p0,v0), mask0) );
+        _mm256_storeu_ps( p + 2*i + 8, _mm256_blendv_ps(p1, _mm256_add_ps(p1,v1), mask1) );
+
+        // linear damping on x only (shuffles stay in 128 bit lanes, unpacking restores the order)
+        __m256 xs = _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(2,0,2,0));
+        __m256 ys = _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(3,1,3,1));
+        xs = damp8(xs, linearStep);
+        _mm256_storeu_ps( v + 2*i, _mm256_blendv_ps(v0, _mm256_unpacklo_ps(xs,ys), mask0) );
+        _mm256_storeu_ps( v + 2*i + 8, _mm256_blendv_ps(v1, _mm256_unpackhi_ps(xs,ys), mask1) );
+    }
+    return count + motionScalar(bodies, i, n);
+}
+
+#endif // PHYSIC_X86
+
+
+
+// --------------------------------------------------------------------------
+void integrateGravity(BodyStore& bodies, const Vec2& dv, SimdLevel level)
+{
+#if defined(PHYSIC_X86)
+    if(level == SIMD_AVX2) { gravityAVX2(bodies, dv); return; }
+    if(level == SIMD_SSE2) { gravitySSE2(bodies, dv); return; }
+#endif
+    gravityScalar(bodies, dv, 0, bodies.size());
+}
+
+// --------------------------------------------------------------------------
+unsigned integrateMotion(BodyStore& bodies, SimdLevel level)
+{
+#if defined(PHYSIC_X86)
+    if(level == SIMD_AVX2) return motionAVX2(bodies);
+    if(level == SIMD_SSE2) return motionSSE2(bodies);
+#endif
+    return motionScalar(bodies, 0, bodies.size());
+}
@@ -0,0 +1,37 @@
+#ifndef PHYSIC_INTEGRATE_HPP
+#define PHYSIC_INTEGRATE_HPP
+
+#include "physic_body.hpp"
+
+
+// --------------------------------------------------------------------------
+// instruction set used by the integration kernels
+enum SimdLevel
+{
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2
+};
+
+// --------------------------------------------------------------------------
+// best level supported by the running cpu
+SimdLevel detectSimdLevel();
+
+// --------------------------------------------------------------------------
+// printable name of a level
+const char* simdLevelName(SimdLevel level);
+
+// --------------------------------------------------------------------------
+// add dv to the linear velocity of every awake body with a mass
+// (vectorized levels are bit-identical to the scalar one)
+void integrateGravity(BodyStore& bodies, const Vec2& dv, SimdLevel level);
+
+// --------------------------------------------------------------------------
+// advance position and rotation of every awake body with a mass, then damp v_linear.x and v_angular
+// the damping steps are double precision constants, the vector kernels compute them in double too,
+// so vectorized levels are bit-identical to the scalar one
+// return the number of bodies integrated
+unsigned integrateMotion(BodyStore& bodies, SimdLevel level);
+
+
+#endif // PHYSIC_INTEGRATE_HPP
@@ -0,0 +1,187 @@
+#include "physic_island.hpp"
+#include <algorithm>
+
+#define NO_NODE (~0u)
+
+// --------------------------------------------------------------------------
+unsigned solverSlot(const Entity* e, const BodyStore& bodies)
+{
+    if(e->store != &bodies || e->mass() == 0.f) return NO_NODE;
+    return e->bodySlot;
+}
+
+
+
+// --------------------------------------------------------------------------
+ContactIslands::ContactIslands() {}
+
+// --------------------------------------------------------------------------
+ContactIslands::~ContactIslands() {}
+
+// --------------------------------------------------------------------------
+unsigned ContactIslands::size() const
+{
+    return start.empty() ? 0 : start.size() - 1;
+}
+
+// --------------------------------------------------------------------------
+unsigned ContactIslands::count(unsigned k) const
+{
+    return start[k+1] - start[k];
+}
+
+// --------------------------------------------------------------------------
+unsigned ContactIslands::find(unsigned slot)
+{
+    // path halving
+    while(parent[slot] != slot)
+    {
+        parent[slot] = parent[ parent[slot] ];
+        slot = parent[slot];
+    }
+    return slot;
+}
+
+// --------------------------------------------------------------------------
+void ContactIslands::merge(unsigned a, unsigned b)
+{
+    a = find(a);
+    b = find(b);
+    if(a == b) return;
+    
+    // the lowest slot is the root, so islands do not depend on the union order
+    if(a < b) parent[b] = a;
+    else      parent[a] = b;
+}
+
+// --------------------------------------------------------------------------
+void ContactIslands::build(const Arr<CollisionData>& collisions, const BodyStore& store)
+{
+    group(collisions, store);
+}
+
+// --------------------------------------------------------------------------
+void ContactIslands::build(const Arr<EntityPair>& pairs, const BodyStore& store)
+{
+    group(pairs, store);
+}
+
+// --------------------------------------------------------------------------
+template<class Item>
+void ContactIslands::group(const Arr<Item>& items, const BodyStore& store)
+{
+    contacts.clear();
+    start.clear();
+    order.clear();
+    contactIsland.clear();
+    
+    bodies.clear();
+    bodyStart.clear();
+    
+    // islands of the previous build
+    for(auto s : touched) island[s] = NO_NODE;
+    touched.clear();
+    
+    if(parent.size() < store.size())
+    {
+        parent.resize(store.size(), NO_NODE);
+        island.resize(store.size(), NO_NODE);
+    }
+    
+    // union of the 2 bodies of every contact
+    for(auto& item : items)
+    {
+        unsigned n[2] = { solverSlot(item.e1,store), solverSlot(item.e2,store) };
+        for(auto s : n)
+        {
+            if(s == NO_NODE || parent[s] != NO_NODE) continue;
+            parent[s] = s;
+            touched.push_back(s);
+        }
+        if(n[0] != NO_NODE && n[1] != NO_NODE) merge(n[0], n[1]);
+    }
+    
+    // island of each contact, numbered by first contact, and contact count per island
+    Arr<unsigned>& counts = start;
+    for(auto& item : items)
+    {
+        unsigned s = solverSlot(item.e1,store);
+        if(s == NO_NODE) s = solverSlot(item.e2,store);
+        
+        // no body to move : the contact is an island of its own
+        unsigned k = counts.size();
+        if(s != NO_NODE)
+        {
+            unsigned root = find(s);
+            if(island[root] == NO_NODE) island[root] = k;
+            else k = island[root];
+        }
+        
+        if(k == counts.size()) counts.push_back(0);
+        counts[k]++;
+        contactIsland.push_back(k);
+    }
+    
+    // order of the islands for the scheduler
+    unsigned islandCount = counts.size();
+    for(unsigned k=0; k<islandCount; ++k) order.push_back(k);
+    std::sort(order.begin(), order.end(), [&counts](unsigned a, unsigned b)
+    {
+        return counts[a] > counts[b] || (counts[a] == counts[b] && a < b);
+    });
+    
+    // counts to offsets, then contacts placed in their order (stable)
+    unsigned offset = 0;
+    for(unsigned k=0; k<islandCount; ++k)
+    {
+        unsigned c = counts[k];
+        counts[k] = offset;
+        offset += c;
+    }
+    counts.push_back(offset);
+    
+    contacts.resize(items.size());
+    for(unsigned i=0; i<items.size(); ++i) contacts[ start[contactIsland[i]]++ ] = i;
+    
+    // start[k] now holds the end of island k : shifted back
+    for(unsigned k=islandCount; k>0; --k) start[k] = start[k-1];
+    start[0] = 0;
+    
+    // bodies grouped by island the same way (every touched slot has a contact, so an island)
+    bodyStart.resize(islandCount+1, 0);
+    for(auto s : touched) bodyStart[ island[find(s)] + 1 ]++;
+    for(unsigned k=0; k<islandCount; ++k) bodyStart[k+1] += bodyStart[k];
+    bodies.resize(touched.size());
+    for(auto s : touched) bodies[ bodyStart[ island[find(s)] ]++ ] = s;
+    for(unsigned k=islandCount; k>0; --k) bodyStart[k] = bodyStart[k-1];
+    bodyStart[0] = 0;
+    
+    // every slot knows its island, the union-find is left clean for the next build
+    for(auto s : touched) island[s] = island[find(s)];
+    for(auto s : touched) parent[s] = NO_NODE;
+}
+
+// --------------------------------------------------------------------------
+unsigned ContactIslands::islandOf(unsigned slot) const
+{
+    return slot < island.size() ? island[slot] : NO_NODE;
+}
+
+// --------------------------------------------------------------------------
+void ContactIslands::reserve(unsigned bodyCount, unsigned itemCount)
+{
+    if(parent.size() < bodyCount)
+    {
+        parent.resize(bodyCount, NO_NODE);
+        island.resize(bodyCount, NO_NODE);
+    }
+    touched.reserve(bodyCount);
+    bodies.reserve(bodyCount);
+    
+    // an island has a contact at least
+    contacts.reserve(itemCount);
+    contactIsland.reserve(itemCount);
+    start.reserve(itemCount+1);
+    order.reserve(itemCount);
+    bodyStart.reserve(itemCount+1);
+}
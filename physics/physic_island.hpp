@@ -0,0 +1,73 @@
+#ifndef PHYSIC_ISLAND_HPP
+#define PHYSIC_ISLAND_HPP
+
+#include "physic_broadphase.hpp"
+
+
+// --------------------------------------------------------------------------
+// slot of e in bodies if the solver moves it, ~0u otherwise (static, massless or other store)
+unsigned solverSlot(const Entity* e, const BodyStore& bodies);
+
+// --------------------------------------------------------------------------
+// groups of contacts sharing no dynamic body, solvable independently
+// built by union-find over the bodies of a store : static and massless bodies are never
+// moved by the solver, so they do not join islands (a pile on the ground is not merged with
+// every other pile on the same ground)
+struct ContactIslands
+{
+    // contact indices grouped by island, in contact order inside an island
+    // island k covers [start[k];start[k+1])
+    Arr<unsigned> contacts;
+    Arr<unsigned> start;
+    
+    // islands sorted by decreasing contact count
+    Arr<unsigned> order;
+    
+    // body slots of each island, island k covers [bodyStart[k];bodyStart[k+1])
+    Arr<unsigned> bodies;
+    Arr<unsigned> bodyStart;
+    
+    ContactIslands();
+    virtual ~ContactIslands();
+    
+    // number of islands
+    unsigned size() const;
+    
+    // number of contacts of island k
+    unsigned count(unsigned k) const;
+    
+    // group the collisions, store is the store of the dynamic bodies
+    // bodies without contact cost nothing : only the slots of the contacts are visited
+    void build(const Arr<CollisionData>& collisions, const BodyStore& store);
+    
+    // same with candidate pairs (contacts are then pair indices)
+    void build(const Arr<EntityPair>& pairs, const BodyStore& store);
+    
+    // island of a body slot in the last build (~0u if the body had no contact)
+    unsigned islandOf(unsigned slot) const;
+    
+    // room for builds of itemCount contacts or pairs over bodyCount body slots, without allocation
+    void reserve(unsigned bodyCount, unsigned itemCount);
+    
+protected:
+    // items have the 2 bodies e1 and e2
+    template<class Item>
+    void group(const Arr<Item>& items, const BodyStore& store);
+    
+    unsigned find(unsigned slot);
+    void merge(unsigned a, unsigned b);
+    
+    // per body slot : union-find parent and island index (~0u when unused)
+    // island indices stay valid until the next build
+    Arr<unsigned> parent;
+    Arr<unsigned> island;
+    
+    // slots given a parent during the last build
+    Arr<unsigned> touched;
+    
+    // island of each contact
+    Arr<unsigned> contactIsland;
+};
+
+
+#endif // PHYSIC_ISLAND_HPP
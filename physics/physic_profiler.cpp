@@ -0,0 +1,141 @@
+#include "physic_profiler.hpp"
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+
+// --------------------------------------------------------------------------
+const char* phaseName(PhysicPhase phase)
+{
+    switch(phase)
+    {
+        case PHASE_GRAVITY : return "gravity";
+        case PHASE_COLLECT : return "collect";
+        case PHASE_RESOLVE : return "resolve";
+        case PHASE_ADVANCE : return "advance";
+        default : return "unknown";
+    }
+}
+
+// --------------------------------------------------------------------------
+PhysicProfiler::~PhysicProfiler() {}
+
+
+
+// --------------------------------------------------------------------------
+unsigned long long traceClock()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count();
+}
+
+// --------------------------------------------------------------------------
+unsigned traceThreadId()
+{
+    static std::atomic<unsigned> count(0);
+    thread_local unsigned id = count.fetch_add(1);
+    return id;
+}
+
+
+
+// --------------------------------------------------------------------------
+PhysicTrace::PhysicTrace(unsigned capacity)
+    : next(0)
+    , origin( traceClock() )
+{
+    unsigned size = 1;
+    while(size < capacity) size <<= 1;
+    mask = size-1;
+
+    slots = new Slot[size];
+    for(unsigned i=0; i<size; ++i) slots[i].tag.store(0, std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------
+PhysicTrace::~PhysicTrace()
+{
+    delete[] slots;
+}
+
+// --------------------------------------------------------------------------
+void PhysicTrace::record(const char* name, unsigned long long begin, unsigned long long end)
+{
+    unsigned long long index = next.fetch_add(1, std::memory_order_relaxed);
+    Slot& s = slots[index & mask];
+
+    // tag 0 : being written
+    s.tag.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.name.store(name, std::memory_order_relaxed);
+    s.begin.store(begin, std::memory_order_relaxed);
+    s.end.store(end, std::memory_order_relaxed);
+    s.thread.store(traceThreadId(), std::memory_order_relaxed);
+    s.tag.store(index+1, std::memory_order_release);
+}
+
+// --------------------------------------------------------------------------
+unsigned long long PhysicTrace::recorded() const
+{
+    return next.load(std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------------------------
+void PhysicTrace::clear()
+{
+    for(unsigned i=0; i<=mask; ++i) slots[i].tag.store(0, std::memory_order_relaxed);
+    next.store(0, std::memory_order_release);
+}
+
+// --------------------------------------------------------------------------
+void PhysicTrace::events(Arr<TraceEvent>& out) const
+{
+    out.clear();
+    unsigned long long last = next.load(std::memory_order_acquire);
+    unsigned long long first = last > mask ? last - mask - 1 : 0;
+
+    for(unsigned long long index=first; index<last; ++index)
+    {
+        const Slot& s = slots[index & mask];
+        if(s.tag.load(std::memory_order_acquire) != index+1) continue;
+
+        TraceEvent e;
+        e.name = s.name.load(std::memory_order_relaxed);
+        e.begin = s.begin.load(std::memory_order_relaxed);
+        e.end = s.end.load(std::memory_order_relaxed);
+        e.thread = s.thread.load(std::memory_order_relaxed);
+
+        // overwritten while reading
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(s.tag.load(std::memory_order_relaxed) != index+1) continue;
+
+        out.push_back(e);
+    }
+}
+
+// --------------------------------------------------------------------------
+void PhysicTrace::writeChromeTrace(std::ostream& out) const
+{
+    Arr<TraceEvent> list;
+    events(list);
+    std::stable_sort(list.begin(), list.end(), [](const TraceEvent& a, const TraceEvent& b){ return a.begin < b.begin; });
+
+    // complete events ("X"), timestamps in microseconds
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    
+    out << "{\"traceEvents\":[" << std::endl;
+    for(unsigned i=0; i<list.size(); ++i)
+    {
+        const TraceEvent& e = list[i];
+        double ts = e.begin >= origin ? (e.begin - origin) * 1e-3 : 0.0;
+        double dur = e.end >= e.begin ? (e.end - e.begin) * 1e-3 : 0.0;
+        out << "{\"name\":\"" << e.name << "\",\"cat\":\"physics\",\"ph\":\"X\",\"pid\":1"
+            << ",\"tid\":" << e.thread << ",\"ts\":" << ts << ",\"dur\":" << dur << "}"
+            << (i+1 < list.size() ? "," : "") << std::endl;
+    }
+    out << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+    
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,111 @@
+#ifndef PHYSIC_PROFILER_HPP
+#define PHYSIC_PROFILER_HPP
+
+#include <atomic>
+#include <ostream>
+#include "../maths/math_vector.hpp"
+
+
+// --------------------------------------------------------------------------
+// stages of PhysicEngine::updateEntities
+enum PhysicPhase
+{
+    PHASE_GRAVITY,
+    PHASE_COLLECT,
+    PHASE_RESOLVE,
+    PHASE_ADVANCE,
+    PHASE_COUNT
+};
+
+// --------------------------------------------------------------------------
+// printable name of a phase
+const char* phaseName(PhysicPhase phase);
+
+// --------------------------------------------------------------------------
+// notified around each phase of an engine update (see PhysicEngine::profiler)
+// calls come from the thread calling updateEntities
+struct PhysicProfiler
+{
+    virtual ~PhysicProfiler();
+
+    virtual void beginPhase(PhysicPhase phase) = 0;
+    virtual void endPhase(PhysicPhase phase) = 0;
+};
+
+// --------------------------------------------------------------------------
+// monotonic clock used by the stats and the traces (nanoseconds)
+unsigned long long traceClock();
+
+// --------------------------------------------------------------------------
+// small id of the calling thread (0 for the first thread asking, then 1, 2...)
+unsigned traceThreadId();
+
+// --------------------------------------------------------------------------
+// scoped event of a trace
+struct TraceEvent
+{
+    // name must outlive the trace (string literal)
+    const char* name;
+    unsigned long long begin;
+    unsigned long long end;
+    unsigned thread;
+};
+
+// --------------------------------------------------------------------------
+// lock-free ring buffer of scoped events, any thread can record
+// when full, the oldest events are overwritten
+// a slot is tagged with the index of the event written in it, so a dump running
+// while events are recorded skips the slots being written instead of reading torn events
+struct PhysicTrace
+{
+    // capacity : rounded up to a power of 2
+    PhysicTrace(unsigned capacity = 1<<16);
+    virtual ~PhysicTrace();
+
+    // add an event
+    void record(const char* name, unsigned long long begin, unsigned long long end);
+
+    // number of events recorded since the last clear (including overwritten ones)
+    unsigned long long recorded() const;
+
+    // forget all events (not thread safe against record)
+    void clear();
+
+    // readable events, oldest first
+    void events(Arr<TraceEvent>& out) const;
+
+    // write the events in Chrome trace format (chrome://tracing, Perfetto)
+    void writeChromeTrace(std::ostream& out) const;
+
+protected:
+    struct Slot
+    {
+        std::atomic<unsigned long long> tag;
+        std::atomic<const char*> name;
+        std::atomic<unsigned long long> begin;
+        std::atomic<unsigned long long> end;
+        std::atomic<unsigned> thread;
+    };
+
+    Slot* slots;
+    unsigned mask;
+    std::atomic<unsigned long long> next;
+
+    // clock value of the trace creation, origin of the dumped timestamps
+    unsigned long long origin;
+};
+
+// --------------------------------------------------------------------------
+// record an event covering the scope of this object, nothing but a test if trace is null
+struct TraceScope
+{
+    PhysicTrace* trace;
+    const char* name;
+    unsigned long long begin;
+
+    TraceScope(PhysicTrace* t, const char* n) : trace(t), name(n), begin(t ? traceClock() : 0) {}
+    ~TraceScope() { if(trace) trace->record(name, begin, traceClock()); }
+};
+
+
+#endif // PHYSIC_PROFILER_HPP
@@ -0,0 +1,122 @@
+#ifndef PHYSIC_RESPONSE_HPP
+#define PHYSIC_RESPONSE_HPP
+
+#include "../maths/math_vector.hpp"
+#include <cmath>
+#include <algorithm>
+
+// stages of the contact response of one body, shared by PhysicEngine::resolveCollision and the
+// scalar lanes of the colored solver, so both compute the same operations in the same order
+// (std::tan and std::atan are applied between the stages, per lane in the colored solver)
+
+// constants of the contact response
+#define PENETRATION_EPSILON 0.02f
+#define CONTACT_FRICTION 0.7f
+
+// --------------------------------------------------------------------------
+// rotation of 90 degrees, from the direction to the hit point to its tangent
+inline const Transform& responseRot90()
+{
+    static const Transform r = Transform().rotate(90.0);
+    return r;
+}
+
+// --------------------------------------------------------------------------
+// distance to move the bodies apart
+inline float penetrationCorrection(float penetration)
+{
+    return penetration * (1.0+PENETRATION_EPSILON);
+}
+
+// --------------------------------------------------------------------------
+// resolvePenetration : move p1 along n2 and p2 along n1, by the mass ratio of each body
+// (a body without mass is not written)
+inline void separateBodies(float m1, float m2, float correction, const Vec2& n1, const Vec2& n2, Vec2& p1, Vec2& p2)
+{
+    float massTT = m1 + m2;
+    if(massTT == 0.f) return;
+
+    float ratio1 = m1 / massTT;
+    float ratio2 = m2 / massTT;
+    if(ratio1 != 0.f) p1 += n2 * correction * ratio1;
+    if(ratio2 != 0.f) p2 += n1 * correction * ratio2;
+}
+
+// --------------------------------------------------------------------------
+// applyImpulse up to the angle : add the linear part of impulse to v, return the tangent
+// impulse over the distance to the hit point (argument of impulseAngle)
+inline float impulseLinear(const Vec2& hitPoint, const Vec2& position, const Vec2& impulse, Vec2& v)
+{
+    Vec2 toHit = hitPoint - position;
+    Vec2 fromO = normalize(toHit);
+    Vec2 tan = responseRot90() * fromO;
+    float hitPoint_dist = len(toHit);
+
+    v += fromO * dot(fromO, impulse);
+    return dot(impulse, tan) / hitPoint_dist;
+}
+
+// --------------------------------------------------------------------------
+// angular impulse (degrees) of an impulseLinear result
+inline float impulseAngle(float tanImpulse)
+{
+    return std::atan(tanImpulse) * 180.0 / 3.1415;
+}
+
+// --------------------------------------------------------------------------
+// end of applyImpulse : the angular velocity becomes the angular impulse
+// (an angle below 90 degrees, whose std::tan gives the next tangent velocity : an angular
+// velocity added up could pass 90 degrees and launch the body)
+inline void impulseAngular(float angularImpulse, float& w)
+{
+    angularImpulse -= w;
+    w += angularImpulse;
+}
+
+// --------------------------------------------------------------------------
+// applyResponse up to the tangent velocity : argument of its std::tan
+inline float responseAngle(float w)
+{
+    return w * 3.1415f / 180.f;
+}
+
+// --------------------------------------------------------------------------
+// tangent at the hit point and distance to it
+inline void responseTangent(const Vec2& hitPoint, const Vec2& position, Vec2& tan, float& hitPoint_dist)
+{
+    Vec2 toHit = hitPoint - position;
+    tan = responseRot90() * normalize(toHit);
+    hitPoint_dist = len(toHit);
+}
+
+// --------------------------------------------------------------------------
+// end of applyResponse : impulse of a body of mass m (not null) against a body of mass mOther
+// along normal2, tanValue is the std::tan of responseAngle
+// normalImpulse is the normal impulse already applied this step (warm start), the response
+// corrects it and keeps it positive, the restitution and friction parts are not accumulated
+inline Vec2 responseImpulse(const Vec2& tan, float tanValue, float hitPoint_dist, const Vec2& v, const Vec2& normal2, float m, float mOther, float restitution, float& normalImpulse)
+{
+    Vec2 surface2 = responseRot90() * -normal2;
+    Vec2 tanVel = tan * tanValue * hitPoint_dist;
+    Vec2 velocityAtContact = v + tanVel;
+
+    // velocity
+    float approach = -dot(normal2,velocityAtContact);
+    float slow = dot(surface2,velocityAtContact);
+    float response = 1.0;
+    if(mOther != 0.f) response = m / (m + mOther);
+
+    // an approach is shared with the other body, a warm start which pushed too far is taken back
+    float rate = approach > 0.f ? response : 1.0f;
+    float accumulated = std::max( normalImpulse + approach * rate , 0.0f);
+    float correction = accumulated - normalImpulse;
+    float bounce = std::max( approach , 0.0f) * restitution;
+    normalImpulse = accumulated;
+
+    Vec2 impulseVec = normal2 * (correction + bounce);
+    impulseVec -= surface2 * slow * CONTACT_FRICTION;
+    return impulseVec;
+}
+
+
+#endif // PHYSIC_RESPONSE_HPP
@@ -0,0 +1,163 @@
+#include "physic_threadpool.hpp"
+#include <algorithm>
+
+// --------------------------------------------------------------------------
+ThreadPool::ThreadPool(unsigned threadCount)
+    : job(nullptr)
+    , jobCount(0)
+    , jobGrain(1)
+    , nextChunk(0)
+    , busy(0)
+    , generation(0)
+    , quit(false)
+    , queues(nullptr)
+{
+    if(threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    queues = new TaskQueue[threadCount];
+    
+    for(unsigned i=1; i<threadCount; ++i) workers.push_back( std::thread(&ThreadPool::workerLoop, this) );
+}
+
+// --------------------------------------------------------------------------
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wakeUp.notify_all();
+    for(auto& t : workers) t.join();
+    
+    delete[] queues;
+}
+
+// --------------------------------------------------------------------------
+unsigned ThreadPool::size() const
+{
+    return workers.size() + 1;
+}
+
+// --------------------------------------------------------------------------
+void ThreadPool::parallelFor(unsigned count, unsigned grain, const Job& fn)
+{
+    if(count == 0) return;
+    grain = std::max(grain, 1u);
+    
+    // not worth waking the workers
+    if(workers.empty() || count <= grain)
+    {
+        for(unsigned b=0; b<count; b+=grain) fn(b, std::min(count, b+grain));
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        jobGrain = grain;
+        nextChunk = 0;
+        busy = workers.size();
+        generation++;
+    }
+    wakeUp.notify_all();
+    
+    runChunks();
+    
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]{ return busy == 0; });
+    job = nullptr;
+}
+
+// --------------------------------------------------------------------------
+void ThreadPool::parallelTasks(unsigned count, const Task& task)
+{
+    if(count == 0) return;
+    
+    if(workers.empty() || count == 1)
+    {
+        for(unsigned i=0; i<count; ++i) task(i);
+        return;
+    }
+    
+    // the workers are idle : queues are filled without locking
+    unsigned n = size();
+    for(unsigned q=0; q<n; ++q) queues[q].items.clear();
+    for(unsigned i=0; i<count; ++i) queues[i % n].items.push_back(i);
+    for(unsigned q=0; q<n; ++q)
+    {
+        queues[q].head = 0;
+        queues[q].tail = queues[q].items.size();
+    }
+    
+    // one chunk per queue, a thread taking 2 chunks only delays the second queue (which gets stolen from)
+    parallelFor(n, 1, [this,&task](unsigned begin, unsigned)
+    {
+        runQueue(begin, task);
+    });
+}
+
+// --------------------------------------------------------------------------
+void ThreadPool::runQueue(unsigned q, const Task& task)
+{
+    unsigned n = size(), item;
+    
+    while( popFront(queues[q], item) ) task(item);
+    
+    // steal the cheapest items of the others until all queues are empty
+    for(unsigned k=1; k<n; ++k)
+    {
+        TaskQueue& victim = queues[(q+k) % n];
+        while( popBack(victim, item) ) task(item);
+    }
+}
+
+// --------------------------------------------------------------------------
+bool ThreadPool::popFront(TaskQueue& queue, unsigned& item)
+{
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(queue.head == queue.tail) return false;
+    item = queue.items[queue.head++];
+    return true;
+}
+
+// --------------------------------------------------------------------------
+bool ThreadPool::popBack(TaskQueue& queue, unsigned& item)
+{
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(queue.head == queue.tail) return false;
+    item = queue.items[--queue.tail];
+    return true;
+}
+
+// --------------------------------------------------------------------------
+void ThreadPool::runChunks()
+{
+    for(;;)
+    {
+        unsigned k = nextChunk++;
+        if( (unsigned long long)k*jobGrain >= jobCount ) break;
+        
+        unsigned b = k*jobGrain;
+        (*job)(b, std::min(jobCount, b+jobGrain));
+    }
+}
+
+// --------------------------------------------------------------------------
+void ThreadPool::workerLoop()
+{
+    unsigned seen = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [&]{ return quit || generation != seen; });
+            if(quit) return;
+            seen = generation;
+        }
+        
+        runChunks();
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--busy == 0) finished.notify_one();
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef PHYSIC_THREADPOOL_HPP
+#define PHYSIC_THREADPOOL_HPP
+
+#include "../maths/math_vector.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+// --------------------------------------------------------------------------
+// persistent worker threads running parallel loops
+// the calling thread takes part in the loop, so a pool of size 1 has no worker
+// a pool holds the state of one loop : its loops must be started from one thread at a time
+// (a pool without worker runs them inline, it can be used by any threads at once)
+struct ThreadPool
+{
+    // job : process the items [begin;end)
+    using Job = std::function<void(unsigned begin, unsigned end)>;
+    
+    // task : process the item i
+    using Task = std::function<void(unsigned i)>;
+
+    // constructor
+    // threadCount : total number of threads, 0 for one per hardware core
+    ThreadPool(unsigned threadCount = 0);
+    virtual ~ThreadPool();
+
+    // number of threads used by a loop (workers + caller)
+    unsigned size() const;
+
+    // run job over [0;count) split in chunks of grain items, returns once all chunks are done
+    // chunk k always covers [k*grain;(k+1)*grain), whatever the thread count
+    // loops must not be nested
+    void parallelFor(unsigned count, unsigned grain, const Job& job);
+    
+    // run task over [0;count) with work stealing, returns once all items are done
+    // items are dealt in turn to one queue per thread, a thread runs its queue from the front
+    // then steals from the back of the others, so a long item does not hold the short ones
+    // give the items by decreasing cost for the best balance
+    // not nestable with parallelFor
+    void parallelTasks(unsigned count, const Task& task);
+
+protected:
+    // items of a thread, [head;tail) still to run
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        Arr<unsigned> items;
+        unsigned head;
+        unsigned tail;
+    };
+    
+    void workerLoop();
+    void runChunks();
+    void runQueue(unsigned q, const Task& task);
+    bool popFront(TaskQueue& queue, unsigned& item);
+    bool popBack(TaskQueue& queue, unsigned& item);
+
+    Arr<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable finished;
+
+    // current loop
+    const Job* job;
+    unsigned jobCount;
+    unsigned jobGrain;
+    std::atomic<unsigned> nextChunk;
+
+    // workers still running the current loop
+    unsigned busy;
+
+    // incremented at each loop, so sleeping workers detect a new job
+    unsigned generation;
+    bool quit;
+    
+    // work stealing queues, one per thread
+    TaskQueue* queues;
+};
+
+
+#endif // PHYSIC_THREADPOOL_HPP
@@ -0,0 +1,135 @@
+#include "physic_worldgroup.hpp"
+#include <algorithm>
+
+// --------------------------------------------------------------------------
+WorldSlot::WorldSlot(PhysicEngine* e)
+    : engine(e)
+    , paused(false)
+    , interval(1)
+    , stepTime(0.0)
+    , cost(0)
+    , steps(0)
+    , waited(0)
+    , pending(0.f)
+{}
+
+
+
+// --------------------------------------------------------------------------
+PhysicWorldGroup::PhysicWorldGroup(unsigned threadCount)
+    : tickTime(0.0)
+    , pool( new ThreadPool(threadCount) )
+    , inlinePool( new ThreadPool(1) )
+{}
+
+// --------------------------------------------------------------------------
+PhysicWorldGroup::~PhysicWorldGroup()
+{
+    for(auto& w : worlds) delete w.engine;
+    delete inlinePool;
+    delete pool;
+}
+
+// --------------------------------------------------------------------------
+unsigned PhysicWorldGroup::threadCount() const
+{
+    return pool->size();
+}
+
+// --------------------------------------------------------------------------
+PhysicEngine* PhysicWorldGroup::createWorld(Broadphase* bp)
+{
+    // a pool without worker runs the loops of the world inline, on the thread stepping it
+    PhysicEngine* engine = new PhysicEngine(bp, inlinePool);
+    worlds.push_back( WorldSlot(engine) );
+    return engine;
+}
+
+// --------------------------------------------------------------------------
+void PhysicWorldGroup::destroyWorld(PhysicEngine* engine)
+{
+    for(unsigned i=0; i<worlds.size(); ++i)
+    {
+        if(worlds[i].engine != engine) continue;
+        worlds.erase(worlds.begin() + i);
+        delete engine;
+        return;
+    }
+}
+
+// --------------------------------------------------------------------------
+WorldSlot* PhysicWorldGroup::find(PhysicEngine* engine)
+{
+    for(auto& w : worlds)
+        if(w.engine == engine) return &w;
+    return nullptr;
+}
+
+// --------------------------------------------------------------------------
+void PhysicWorldGroup::setPaused(PhysicEngine* engine, bool paused)
+{
+    WorldSlot* w = find(engine);
+    if(w) w->paused = paused;
+}
+
+// --------------------------------------------------------------------------
+void PhysicWorldGroup::setInterval(PhysicEngine* engine, unsigned interval)
+{
+    WorldSlot* w = find(engine);
+    if(!w) return;
+    w->interval = std::max(interval, 1u);
+    
+    // worlds given the same interval are due at different ticks (offset by their index)
+    w->waited = (unsigned)(w - &worlds[0]) % w->interval;
+    w->pending = 0.f;
+}
+
+// --------------------------------------------------------------------------
+void PhysicWorldGroup::step(float elapsedSec)
+{
+    unsigned long long start = traceClock();
+    
+    due.clear();
+    for(unsigned i=0; i<worlds.size(); ++i)
+    {
+        WorldSlot& w = worlds[i];
+        w.stepTime = 0.0;
+        if(w.paused) continue;
+        
+        w.pending += elapsedSec;
+        if(++w.waited < w.interval) continue;
+        
+        // never stepped : the bodies are the only estimate
+        if(w.steps == 0) w.cost = w.engine->bodies.size();
+        due.push_back(i);
+    }
+    
+    // dealt by decreasing cost : the big worlds start first, the small ones fill the gaps
+    std::sort(due.begin(), due.end(), [this](unsigned a, unsigned b)
+    {
+        return worlds[a].cost > worlds[b].cost || (worlds[a].cost == worlds[b].cost && a < b);
+    });
+    
+    pool->parallelTasks(due.size(), [this](unsigned k)
+    {
+        stepWorld( worlds[ due[k] ] );
+    });
+    
+    tickTime = (traceClock() - start) * 1e-6;
+}
+
+// --------------------------------------------------------------------------
+void PhysicWorldGroup::stepWorld(WorldSlot& w)
+{
+    // a single step of one tick time : velocities are in pixels per step, so a longer step would
+    // give the gravity of every tick but move the bodies once, the other ticks waited are dropped
+    // (a throttled world runs slower instead of catching up)
+    unsigned long long start = traceClock();
+    w.engine->updateEntities(w.pending / w.waited);
+    w.stepTime = (traceClock() - start) * 1e-6;
+    
+    w.cost = w.engine->bodies.size() + w.engine->collisions.size();
+    w.steps++;
+    w.waited = 0;
+    w.pending = 0.f;
+}
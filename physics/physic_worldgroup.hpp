@@ -0,0 +1,86 @@
+#ifndef PHYSIC_WORLDGROUP_HPP
+#define PHYSIC_WORLDGROUP_HPP
+
+#include "physic_engine.hpp"
+
+
+// --------------------------------------------------------------------------
+// a world of a group, its scheduling settings and its last results
+struct WorldSlot
+{
+    PhysicEngine* engine;
+    
+    // a paused world is skipped (its time does not advance)
+    bool paused;
+    
+    // stepped once every interval ticks (1 : every tick), by a single step of one tick time
+    unsigned interval;
+    
+    // duration of the steps of the last tick (milliseconds, 0 if not stepped at the last tick)
+    double stepTime;
+    
+    // load estimate used to order the worlds : bodies + contacts of the last step
+    unsigned cost;
+    
+    // engine steps done
+    unsigned long long steps;
+    
+    // ticks and time since the last step
+    unsigned waited;
+    float pending;
+    
+    WorldSlot(PhysicEngine* e = nullptr);
+};
+
+// --------------------------------------------------------------------------
+// many independent worlds stepped together on one pool
+// a tick runs the due worlds as work stealing tasks, the most expensive ones first,
+// each world runs its own phases on the thread which took it (the pool does not nest)
+struct PhysicWorldGroup
+{
+    // worlds, in creation order
+    Arr<WorldSlot> worlds;
+    
+    // duration of the last tick (milliseconds)
+    double tickTime;
+    
+    // threadCount : threads of the group pool, 0 for one per hardware core
+    PhysicWorldGroup(unsigned threadCount = 0);
+    virtual ~PhysicWorldGroup();
+    
+    // number of threads stepping the worlds
+    unsigned threadCount() const;
+    
+    // create a world owned by the group
+    // bp : pair finder, owned by the world (sweep and prune if null), it must not use its own threads
+    PhysicEngine* createWorld(Broadphase* bp = nullptr);
+    
+    // delete a world of the group (its entities are not deleted)
+    void destroyWorld(PhysicEngine* engine);
+    
+    // slot of a world (null if not in the group)
+    WorldSlot* find(PhysicEngine* engine);
+    
+    // pause or resume a world
+    void setPaused(PhysicEngine* engine, bool paused);
+    
+    // step a world once every interval ticks (1 for every tick) : it does 1/interval of the work
+    // and its time runs 1/interval as fast, the worlds with a same interval are due at different ticks
+    void setInterval(PhysicEngine* engine, unsigned interval);
+    
+    // advance the time of the group : step each due world
+    void step(float elapsedSec);
+    
+protected:
+    void stepWorld(WorldSlot& w);
+    
+    // threads of the group, and the pool without worker given to the worlds
+    ThreadPool* pool;
+    ThreadPool* inlinePool;
+    
+    // indices of the worlds due at the current tick
+    Arr<unsigned> due;
+};
+
+
+#endif // PHYSIC_WORLDGROUP_HPP
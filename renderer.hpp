@@ -2,12 +2,17 @@
 #include <SFML/Graphics.hpp>
 #include <iostream>
 
-#include "physics/physic_entity.hpp"
+#include "physics/physic_engine.hpp"
+
+// --------------------------------------------------------------------------
+// physics vector to sfml vector
+inline sf::Vector2f toSf(const Vec2& v) { return sf::Vector2f(v.x, v.y); }
 
 class EntityRenderer
 {
 public:
-    EntityRenderer(sf::RenderWindow* window);
+    // engine : bodies are drawn at its interpolated poses (current poses if null)
+    EntityRenderer(sf::RenderWindow* window, const PhysicEngine* engine = nullptr);
 
     void draw(const Entity* e, const sf::Color& color = sf::Color(50,50,128));
     void draw(const CollisionData& collision);
@@ -17,6 +22,10 @@ public:
     void drawPoint(const Vec2& position);
 
 protected:
+    Vec2 position(const Entity* e) const;
+    float rotation(const Entity* e) const;
+
+    const PhysicEngine* engine;
     sf::RectangleShape sf_rect;
     sf::CircleShape sf_circle;
     sf::RenderWindow* sf_window;
@@ -0,0 +1,162 @@
+#include "scene.hpp"
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+// --------------------------------------------------------------------------
+void buildDemoScene(PhysicEngine& engine, const Vec2& offset)
+{
+    engine.addEntity( new RectEntity(offset+Vec2(230.f, 250.f),50.f,50.f) );
+    engine.addEntity( new RectEntity(offset+Vec2(240.f, 200.f),30.f,30.f) );
+
+    engine.addEntity( new RectEntity(offset+Vec2(200.f, 295.f),20.f,50.f) );
+    engine.addEntity( new RectEntity(offset+Vec2(250.f, 310.f),24.f,14.f) );
+    engine.addEntity( new RectEntity(offset+Vec2(210.f, 320.f),18.f,33.f) );
+    engine.addEntity( new RectEntity(offset+Vec2(300.f, 280.f),54.f,108.f) );
+    engine.addEntity( new RectEntity(offset+Vec2(330.f, 450.f),14.f,24.f) );
+
+    engine.addEntity( new RectEntity(offset+Vec2(305.f, 400.f),18.f,32.f) );
+    engine.addEntity( new RectEntity(offset+Vec2(280.f, 410.f),20.f,50.f) );
+    engine.addEntity( new RectEntity(offset+Vec2(170.f, 340.f),24.f,14.f) );
+    engine.addEntity( new RectEntity(offset+Vec2(190.f, 360.f),18.f,33.f) );
+    engine.addEntity( new RectEntity(offset+Vec2(310.f, 350.f),41.f,10.f) );
+
+
+    engine.addEntity( new CircleEntity(offset+Vec2(204.f, 115.f),5.f) );
+    engine.addEntity( new CircleEntity(offset+Vec2(200.f, 100.f),10.f) );
+    engine.addEntity( new CircleEntity(offset+Vec2(198.f, 105.f),7.f) );
+    engine.addEntity( new CircleEntity(offset+Vec2(196.f, 90.f),8.f) );
+    engine.addEntity( new CircleEntity(offset+Vec2(199.f, 55.f),14.f) );
+    engine.addEntity( new CircleEntity(offset+Vec2(203.f, 70.f),12.f) );
+
+    engine.addEntity( new CircleEntity(offset+Vec2(304.f, 215.f),5.f) );
+    engine.addEntity( new CircleEntity(offset+Vec2(300.f, 200.f),10.f) );
+    engine.addEntity( new CircleEntity(offset+Vec2(298.f, 205.f),7.f) );
+    engine.addEntity( new CircleEntity(offset+Vec2(296.f, 190.f),8.f) );
+    engine.addEntity( new CircleEntity(offset+Vec2(299.f, 155.f),14.f) );
+    engine.addEntity( new CircleEntity(offset+Vec2(203.f, 170.f),12.f) );
+
+
+    engine.addEntity( new BoxEntity(450.f, 450.f, 30.f, offset+Vec2(250.f, 250.f), 0.f) );
+}
+
+// --------------------------------------------------------------------------
+void buildTiledDemoScene(PhysicEngine& engine, unsigned tiles)
+{
+    for(unsigned i=0; i<tiles; ++i)
+        for(unsigned j=0; j<tiles; ++j)
+            buildDemoScene(engine, Vec2(i*550.f, j*550.f));
+}
+
+// --------------------------------------------------------------------------
+void buildCircleRain(PhysicEngine& engine, unsigned count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> radius(2.f,4.f);
+    std::uniform_real_distribution<float> jitter(-1.f,1.f);
+
+    // circles start on a grid filling the box
+    const float spacing = 10.f;
+    unsigned columns = (unsigned)std::ceil( std::sqrt((float)count) );
+    unsigned rows = (count + columns - 1) / columns;
+    float width = columns * spacing + 40.f;
+    float height = rows * spacing + 40.f;
+    Vec2 center(width*0.5f, height*0.5f);
+
+    // the circles land at about sqrt(2 g height) pixels per step : walls thicker than that
+    // (inner sides unchanged), so they do not go through
+    float thickness = std::max(20.f, height * 0.05f);
+    engine.addEntity( new BoxEntity(width + thickness - 20.f, height + thickness - 20.f, thickness, center, 0.f) );
+
+    for(unsigned k=0; k<count; ++k)
+    {
+        Vec2 p( 20.f + (k%columns + 0.5f) * spacing, 20.f + (k/columns + 0.5f) * spacing );
+        engine.addEntity( new CircleEntity(p + Vec2(jitter(rng),jitter(rng)), radius(rng)) );
+    }
+}
+
+// --------------------------------------------------------------------------
+void buildPyramids(PhysicEngine& engine, unsigned count)
+{
+    const float w = 20.f, h = 12.f;
+    const unsigned base = 20;
+    const unsigned perPyramid = base * (base+1) / 2;
+    unsigned pyramids = (count + perPyramid - 1) / perPyramid;
+
+    float pyramidWidth = (base + 2) * w;
+    float groundWidth = pyramids * pyramidWidth;
+    
+    // the ground goes a pyramid width past the first and last ones, walls at its ends keep the
+    // bodies sliding off a pyramid in the scene
+    float margin = pyramidWidth;
+    float wallHeight = 4.f * base * h;
+    engine.addEntity( new RectEntity(Vec2(groundWidth*0.5f, 0.f), groundWidth + 2.f*margin, 20.f, 0.f) );
+    engine.addEntity( new RectEntity(Vec2(-margin, -wallHeight*0.5f), 20.f, wallHeight, 0.f) );
+    engine.addEntity( new RectEntity(Vec2(groundWidth + margin, -wallHeight*0.5f), 20.f, wallHeight, 0.f) );
+
+    for(unsigned k=0; k<pyramids; ++k)
+    {
+        float x0 = k * pyramidWidth + w;
+        for(unsigned row=0; row<base; ++row)
+        {
+            float y = -10.f - h*0.5f - row * h;
+            for(unsigned i=0; i<base-row; ++i)
+                engine.addEntity( new RectEntity(Vec2(x0 + (row*0.5f + i + 0.5f) * w, y), w, h) );
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+void buildSparseWorld(PhysicEngine& engine, unsigned count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> place(0.f,1.f);
+
+    // one cluster of 8 bodies every 800x800 cell on average, most of the world is empty
+    const unsigned perCluster = 8;
+    unsigned clusters = (count + perCluster - 1) / perCluster;
+    float side = std::sqrt((float)clusters) * 800.f;
+
+    for(unsigned k=0; k<clusters; ++k)
+    {
+        Vec2 c( place(rng)*side, place(rng)*side );
+        // a floor with a post at each end : the bodies sliding off stay in the cluster
+        engine.addEntity( new RectEntity(c + Vec2(0.f,60.f), 120.f, 10.f, 0.f) );
+        engine.addEntity( new RectEntity(c + Vec2(-65.f,25.f), 10.f, 80.f, 0.f) );
+        engine.addEntity( new RectEntity(c + Vec2(65.f,25.f), 10.f, 80.f, 0.f) );
+        for(unsigned i=0; i<perCluster; ++i)
+        {
+            Vec2 p = c + Vec2( (i%4)*25.f - 37.5f, (i/4)*25.f - 20.f );
+            if(i%2) engine.addEntity( new CircleEntity(p, 8.f) );
+            else engine.addEntity( new RectEntity(p, 16.f, 16.f) );
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+Broadphase* makeBroadphase(const std::string& name, ThreadPool* pool)
+{
+    if(name == "sap") return new SweepAndPrune();
+    if(name == "lbvh") return new LinearBVHBroadphase(pool);
+    if(name == "grid") return new GridBroadphase();
+    if(name == "tree") return new TreeBroadphase();
+    return nullptr;
+}
+
+// --------------------------------------------------------------------------
+void deleteEntity(Entity* e)
+{
+    if(e->shape == SHAPE_GROUP)
+    {
+        for(auto& child : static_cast<GroupEntity*>(e)->entities) deleteEntity(child);
+    }
+    delete e;
+}
+
+// --------------------------------------------------------------------------
+void destroyScene(PhysicEngine& engine)
+{
+    for(auto& e : engine.entities) deleteEntity(e);
+    engine.entities.clear();
+    engine.dynamicEntities.clear();
+}
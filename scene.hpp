@@ -0,0 +1,37 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include "physics/physic_engine.hpp"
+#include <string>
+
+// --------------------------------------------------------------------------
+// demo layout : rectangles and circles falling in a static box
+// offset : translation of the whole layout
+void buildDemoScene(PhysicEngine& engine, const Vec2& offset = Vec2());
+
+// --------------------------------------------------------------------------
+// tiles x tiles copies of the demo layout side by side
+void buildTiledDemoScene(PhysicEngine& engine, unsigned tiles);
+
+// --------------------------------------------------------------------------
+// count circles falling into a static box
+void buildCircleRain(PhysicEngine& engine, unsigned count, unsigned seed = 1);
+
+// --------------------------------------------------------------------------
+// pyramids of rectangles resting on a static ground, about count rectangles in total
+void buildPyramids(PhysicEngine& engine, unsigned count);
+
+// --------------------------------------------------------------------------
+// small clusters of bodies on static floors between 2 posts, scattered over a large empty area
+void buildSparseWorld(PhysicEngine& engine, unsigned count, unsigned seed = 1);
+
+// --------------------------------------------------------------------------
+// broadphase of a name : sap, lbvh, grid or tree (null for another name)
+// pool : threads of the lbvh build
+Broadphase* makeBroadphase(const std::string& name, ThreadPool* pool);
+
+// --------------------------------------------------------------------------
+// delete the registered entities (and the children of groups), the engine must not be updated afterwards
+void destroyScene(PhysicEngine& engine);
+
+#endif // SCENE_HPP
@@ -0,0 +1,440 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <cmath>
+
+#include "physics/physic_engine.hpp"
+#include "physics/physic_worldgroup.hpp"
+#include "scene.hpp"
+
+// headless runner : step the demo scene and print timings
+// usage : PhysicSim [steps] [dt] [trace.json]
+//         PhysicSim determinism [steps]
+//         PhysicSim warmstart [steps]
+//         PhysicSim worlds [count] [steps] [threads]
+//         PhysicSim frames [count] [fps] [budget ms] [defer]
+// trace.json : chrome trace of the steps (chrome://tracing, Perfetto)
+// determinism : hash the world state of deterministic runs with 1, 2, 8 and 32 threads and
+// each supported instruction set, and of every scene stepped with each supported instruction set (scalar, sse2, avx2),
+// exit code 1 if the hashes differ
+// warmstart : mean squared speed of resting pyramids over the second half of the run, with
+// and without warm starting, with each solver, exit code 1 if warm starting is not slower
+// worlds : count copies of the demo scene stepped by a world group, tick and per world times
+// frames : a tiled demo scene stepped by the fixed step scheduler with irregular frame times
+// (around fps, a long stall every 120 frames), steps run, deferred and dropped
+
+// --------------------------------------------------------------------------
+// fnv-1a of the bits of the world state : bodies, then contacts and their impulses
+struct WorldHash
+{
+    unsigned long long h;
+    
+    WorldHash() : h(1469598103934665603ull) {}
+    
+    void add(const void* data, unsigned size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for(unsigned i=0; i<size; ++i) { h ^= bytes[i]; h *= 1099511628211ull; }
+    }
+    void add(float f) { add(&f, sizeof(f)); }
+    void add(const Vec2& v) { add(v.x); add(v.y); }
+};
+
+unsigned long long hashWorld(const PhysicEngine& engine)
+{
+    WorldHash hash;
+    const BodyStore& b = engine.bodies;
+    for(unsigned i=0; i<b.size(); ++i)
+    {
+        hash.add(b.position[i]); hash.add(b.rotation[i]);
+        hash.add(b.v_linear[i]); hash.add(b.v_angular[i]);
+    }
+    for(auto& coll : engine.collisions)
+    {
+        unsigned keys[2] = { engine.bodyKey(coll.e1), engine.bodyKey(coll.e2) };
+        hash.add(keys, sizeof(keys));
+        hash.add(coll.normalImpulse1); hash.add(coll.normalImpulse2);
+    }
+    return hash.h;
+}
+
+// --------------------------------------------------------------------------
+struct DeterminismCase
+{
+    const char* scene;
+    const char* broadphase;
+    SolverMode solver;
+};
+
+void buildCase(PhysicEngine& engine, const char* scene)
+{
+    if(!std::strcmp(scene, "demo")) buildDemoScene(engine);
+    else if(!std::strcmp(scene, "pyramids")) buildPyramids(engine, 840);
+    else if(!std::strcmp(scene, "circle_rain")) buildCircleRain(engine, 2000);
+    else buildTiledDemoScene(engine, 3);
+}
+
+// --------------------------------------------------------------------------
+// every scene stepped by the scalar path and by each supported vector level, with each solver :
+// integration kernels, circle pairs grouped per body at every step and batched when they fill
+// the vectors, and colored solver kernels, all runs of a scene and solver must match and each
+// vector level must have batched circles in circle_rain (otherwise its batch test was not compared)
+bool checkSimdLevels(unsigned steps)
+{
+    static const SimdLevel levels[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+    static const char* scenes[] = { "demo", "tiled_demo", "pyramids", "circle_rain" };
+    static const SolverMode solvers[] = { SOLVER_ISLANDS, SOLVER_COLORED };
+    
+    bool same = true;
+    unsigned long rainBatched[SIMD_AVX2+1] = {};
+    for(auto scene : scenes)
+    {
+        for(auto solver : solvers)
+        {
+            unsigned long long reference = 0;
+            for(auto level : levels)
+            {
+                if(level > detectSimdLevel()) break;
+                
+                ThreadPool pool(1);
+                PhysicEngine engine(nullptr, &pool);
+                engine.allowSleep = true;
+                engine.simdLevel = level;
+                engine.solverMode = solver;
+                engine.circleBatching = BATCH_ALWAYS;
+                buildCase(engine, scene);
+                
+                unsigned long batched = 0, circles = 0;
+                for(unsigned i=0; i<steps; ++i)
+                {
+                    engine.updateEntities(1.f/60.f);
+                    batched += engine.stats.batchedCirclePairs;
+                    circles += engine.stats.circlePairs;
+                }
+                unsigned long long h = hashWorld(engine);
+                destroyScene(engine);
+                
+                if(level == SIMD_SCALAR) reference = h;
+                if(!std::strcmp(scene, "circle_rain")) rainBatched[level] += batched;
+                
+                char hex[17];
+                std::snprintf(hex, sizeof(hex), "%016llx", h);
+                std::cout << scene << std::string(12 - std::string(scene).size(), ' ')
+                          << (solver == SOLVER_COLORED ? "colored " : "islands ")
+                          << simdLevelName(level) << std::string(7 - std::string(simdLevelName(level)).size(), ' ')
+                          << hex << "  (" << batched << " of " << circles << " circle pairs batched)"
+                          << (h == reference ? "" : "  MISMATCH") << std::endl;
+                if(h != reference) same = false;
+            }
+        }
+    }
+    
+    // the scalar path never batches
+    for(auto level : levels)
+    {
+        if(level == SIMD_SCALAR || level > detectSimdLevel() || rainBatched[level] > 0) continue;
+        std::cout << "circle pairs NOT BATCHED by " << simdLevelName(level) << std::endl;
+        same = false;
+    }
+    return same;
+}
+
+// --------------------------------------------------------------------------
+// every case is run with each thread count and each supported instruction set (lockstep peers
+// may have different cpus), all runs of a scene and solver must match
+// (the broadphases find the same collisions, so they must match too)
+int checkDeterminism(unsigned steps)
+{
+    static const unsigned threads[] = { 1, 2, 8, 32 };
+    static const char* scenes[] = { "demo", "tiled_demo", "pyramids", "circle_rain" };
+    static const char* broadphases[] = { "sap", "lbvh", "grid", "tree" };
+    static const SolverMode solvers[] = { SOLVER_ISLANDS, SOLVER_COLORED };
+    static const SimdLevel levels[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+    
+    bool same = true;
+    for(auto scene : scenes)
+    {
+        for(auto solver : solvers)
+        {
+            unsigned long long reference = 0;
+            bool first = true;
+            for(auto level : levels)
+            {
+                if(level > detectSimdLevel()) break;
+                
+                for(auto bp : broadphases)
+                {
+                    for(auto n : threads)
+                    {
+                        ThreadPool pool(n);
+                        PhysicEngine engine(makeBroadphase(bp, &pool), &pool);
+                        engine.deterministic = true;
+                        engine.allowSleep = true;
+                        engine.solverMode = solver;
+                        engine.circleBatching = BATCH_ALWAYS;
+                        engine.simdLevel = level;
+                        
+                        // small chunks, so the parallel phases really split at these sizes
+                        engine.narrowphaseGrain = 32;
+                        engine.colorGrain = 32;
+                        buildCase(engine, scene);
+                        
+                        for(unsigned i=0; i<steps; ++i) engine.updateEntities(1.f/60.f);
+                        unsigned long long h = hashWorld(engine);
+                        destroyScene(engine);
+                        
+                        if(first) reference = h;
+                        first = false;
+                        
+                        char hex[17];
+                        std::snprintf(hex, sizeof(hex), "%016llx", h);
+                        std::cout << scene << std::string(12 - std::string(scene).size(), ' ')
+                                  << (solver == SOLVER_COLORED ? "colored " : "islands ")
+                                  << simdLevelName(level) << std::string(7 - std::string(simdLevelName(level)).size(), ' ')
+                                  << bp << std::string(5 - std::string(bp).size(), ' ')
+                                  << n << (n < 10 ? "  " : " ") << "threads  " << hex
+                                  << (h == reference ? "" : "  MISMATCH") << std::endl;
+                        if(h != reference) same = false;
+                    }
+                }
+            }
+        }
+    }
+    
+    same = checkSimdLevels(steps) && same;
+    
+    std::cout << (same ? "deterministic" : "NOT deterministic") << " (" << steps << " steps)" << std::endl;
+    return same ? 0 : 1;
+}
+
+// --------------------------------------------------------------------------
+// mean squared speed of the moving bodies
+double meanSpeed2(const PhysicEngine& engine)
+{
+    const BodyStore& b = engine.bodies;
+    double sum = 0.0;
+    for(unsigned i=0; i<b.size(); ++i) sum += len2(b.v_linear[i]);
+    return b.size() ? sum / b.size() : 0.0;
+}
+
+// --------------------------------------------------------------------------
+// the pyramids rest on the ground from the first step : with warm starting, the normal impulses
+// which hold them are found again at each step instead of built up from zero, the bodies must
+// be slower once settled (the second half of the run, bodies never sleep)
+int checkWarmStart(unsigned steps)
+{
+    static const SolverMode solvers[] = { SOLVER_ISLANDS, SOLVER_COLORED };
+    
+    bool faster = true;
+    for(auto solver : solvers)
+    {
+        double rest[2];
+        for(unsigned warm=0; warm<2; ++warm)
+        {
+            ThreadPool pool(1);
+            PhysicEngine engine(nullptr, &pool);
+            engine.solverMode = solver;
+            if(!warm) engine.contactCache.warmStartFactor = 0.f;
+            buildPyramids(engine, 840);
+            
+            double sum = 0.0;
+            for(unsigned i=0; i<steps; ++i)
+            {
+                engine.updateEntities(1.f/60.f);
+                if(i >= steps/2) sum += meanSpeed2(engine);
+            }
+            rest[warm] = sum / std::max(steps - steps/2, 1u);
+            destroyScene(engine);
+        }
+        
+        bool ok = rest[1] < rest[0];
+        std::cout << (solver == SOLVER_COLORED ? "colored " : "islands ")
+                  << "mean v2 at rest " << rest[0] << " without warm start, " << rest[1] << " with"
+                  << (ok ? "" : "  NOT SETTLED FASTER") << std::endl;
+        faster = faster && ok;
+    }
+    
+    std::cout << (faster ? "warm start settles faster" : "warm start does NOT settle faster") << " (" << steps << " steps)" << std::endl;
+    return faster ? 0 : 1;
+}
+
+// --------------------------------------------------------------------------
+// count demo worlds stepped together, timings of the ticks and of the world steps
+int runWorlds(unsigned count, unsigned steps, unsigned threads)
+{
+    PhysicWorldGroup group(threads);
+    for(unsigned i=0; i<count; ++i)
+    {
+        PhysicEngine* world = group.createWorld();
+        world->allowSleep = true;
+        buildDemoScene(*world);
+    }
+    
+    Arr<double> ticks;
+    double worldTotal = 0.0, worldWorst = 0.0;
+    unsigned long long worldSteps = 0;
+    for(unsigned s=0; s<steps; ++s)
+    {
+        group.step(1.f/60.f);
+        ticks.push_back(group.tickTime);
+        for(auto& w : group.worlds)
+        {
+            worldTotal += w.stepTime;
+            worldWorst = std::max(worldWorst, w.stepTime);
+            worldSteps++;
+        }
+    }
+    
+    double total = 0.0;
+    for(auto t : ticks) total += t;
+    std::sort(ticks.begin(), ticks.end());
+    
+    std::cout << "worlds      " << count << " (" << group.worlds[0].engine->bodies.size() << " bodies each)" << std::endl;
+    std::cout << "threads     " << group.threadCount() << std::endl;
+    std::cout << "ticks       " << steps << std::endl;
+    std::cout << "per tick    " << (steps ? total/steps : 0.0) << " ms (p95 " << (steps ? ticks[ std::min(steps*95/100, steps-1) ] : 0.0) << " ms)" << std::endl;
+    std::cout << "per world   " << (worldSteps ? worldTotal/worldSteps : 0.0) << " ms (worst " << worldWorst << " ms)" << std::endl;
+    std::cout << "throughput  " << (total > 0.0 ? worldSteps / (total*1e-3) : 0.0) << " world steps/s" << std::endl;
+    
+    for(auto& w : group.worlds) destroyScene(*w.engine);
+    return 0;
+}
+
+// --------------------------------------------------------------------------
+// count frames of irregular length given to stepFrame
+int runFrames(unsigned count, float fps, double budget, bool defer)
+{
+    ThreadPool pool;
+    PhysicEngine engine(nullptr, &pool);
+    engine.allowSleep = true;
+    engine.frameBudget = budget;
+    engine.deferSteps = defer;
+    buildTiledDemoScene(engine, 4);
+    
+    double frameTotal = 0.0, frameWorst = 0.0, simulated = 0.0, alphaTotal = 0.0;
+    unsigned long steps = 0, deferred = 0, dropped = 0, overBudget = 0;
+    for(unsigned i=0; i<count; ++i)
+    {
+        float frameSec = (1.f + 0.5f * std::sin(i * 0.7f)) / fps;
+        if(i % 120 == 119) frameSec = 0.25f;
+        simulated += frameSec;
+        
+        engine.stepFrame(frameSec);
+        
+        const FrameStats& stats = engine.frameStats;
+        frameTotal += stats.time;
+        frameWorst = std::max(frameWorst, stats.time);
+        steps += stats.steps;
+        deferred += stats.deferredSteps;
+        dropped += stats.droppedSteps;
+        if(stats.overBudget) overBudget++;
+        alphaTotal += engine.alpha;
+    }
+    
+    std::cout << "bodies      " << engine.bodies.size() << " dynamic" << std::endl;
+    std::cout << "frames      " << count << " (" << simulated << " s of frame time, fixed step " << engine.fixedStep << " s)" << std::endl;
+    std::cout << "budget      " << budget << " ms, " << engine.maxSubsteps << " steps per frame, " << (defer ? "defer" : "drop") << std::endl;
+    std::cout << "steps       " << steps << " (" << steps * engine.fixedStep << " s simulated)" << std::endl;
+    std::cout << "left        " << deferred << " deferred, " << dropped << " dropped, " << overBudget << " frames over budget" << std::endl;
+    std::cout << "per frame   " << (count ? frameTotal/count : 0.0) << " ms (worst " << frameWorst << " ms)" << std::endl;
+    std::cout << "alpha       " << (count ? alphaTotal/count : 0.0) << " mean" << std::endl;
+    
+    destroyScene(engine);
+    return 0;
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> args;
+    if(argc>1) args = std::vector<std::string>(argv+1,argv+argc);
+    
+    if(!args.empty() && args[0] == "determinism")
+        return checkDeterminism( args.size() > 1 ? std::stoul(args[1]) : 200 );
+    
+    if(!args.empty() && args[0] == "warmstart")
+        return checkWarmStart( args.size() > 1 ? std::stoul(args[1]) : 600 );
+    
+    if(!args.empty() && args[0] == "worlds")
+        return runWorlds( args.size() > 1 ? std::stoul(args[1]) : 200,
+                          args.size() > 2 ? std::stoul(args[2]) : 300,
+                          args.size() > 3 ? std::stoul(args[3]) : 0 );
+    
+    if(!args.empty() && args[0] == "frames")
+        return runFrames( args.size() > 1 ? std::stoul(args[1]) : 1200,
+                          args.size() > 2 ? std::stof(args[2]) : 60.f,
+                          args.size() > 3 ? std::stod(args[3]) : 0.0,
+                          args.size() > 4 && args[4] == "defer" );
+
+    unsigned steps = args.size() > 0 ? std::stoul(args[0]) : 1000;
+    float dt = args.size() > 1 ? std::stof(args[1]) : 1.f/60.f;
+    std::string tracePath = args.size() > 2 ? args[2] : "";
+
+    ThreadPool pool;
+    PhysicEngine phyEngine(nullptr, &pool);
+    phyEngine.allowSleep = true;
+    buildDemoScene(phyEngine);
+
+    PhysicTrace* trace = tracePath.empty() ? nullptr : new PhysicTrace();
+    phyEngine.trace = trace;
+
+    using Clock = std::chrono::steady_clock;
+    double totalMs = 0.0, worstMs = 0.0;
+    double phaseMs[PHASE_COUNT] = {};
+    unsigned long contacts = 0, pairs = 0, tests = 0, islands = 0;
+    unsigned largestIsland = 0;
+    unsigned long woken = 0;
+    unsigned long circlePairs = 0, batchedCircles = 0, circleBatches = 0;
+
+    for(unsigned i=0; i<steps; ++i)
+    {
+        Clock::time_point start = Clock::now();
+        phyEngine.updateEntities(dt);
+        double ms = std::chrono::duration<double,std::milli>(Clock::now() - start).count();
+
+        totalMs += ms;
+        if(ms > worstMs) worstMs = ms;
+
+        const PhysicStats& stats = phyEngine.stats;
+        for(unsigned p=0; p<PHASE_COUNT; ++p) phaseMs[p] += stats.phaseTime[p];
+        contacts += stats.contacts;
+        pairs += stats.candidatePairs;
+        tests += stats.narrowphaseTests;
+        islands += stats.islands;
+        if(stats.largestIsland > largestIsland) largestIsland = stats.largestIsland;
+        woken += stats.wokenBodies;
+        circlePairs += stats.circlePairs;
+        batchedCircles += stats.batchedCirclePairs;
+        circleBatches += stats.circleBatches;
+    }
+
+    std::cout << "bodies      " << phyEngine.bodies.size() << " dynamic, " << phyEngine.staticGeometry.bodies.size() << " static" << std::endl;
+    std::cout << "simd        " << simdLevelName(phyEngine.simdLevel) << std::endl;
+    std::cout << "steps       " << steps << " (dt " << dt << " s)" << std::endl;
+    std::cout << "total       " << totalMs << " ms" << std::endl;
+    std::cout << "per step    " << (steps ? totalMs/steps : 0.0) << " ms (worst " << worstMs << " ms)" << std::endl;
+    for(unsigned p=0; p<PHASE_COUNT; ++p)
+        std::cout << "  " << phaseName((PhysicPhase)p) << std::string(10 - std::string(phaseName((PhysicPhase)p)).size(), ' ')
+                  << (steps ? phaseMs[p]/steps : 0.0) << " ms" << std::endl;
+    std::cout << "pairs       " << pairs << " (" << tests << " narrowphase tests)" << std::endl;
+    std::cout << "contacts    " << contacts << std::endl;
+    std::cout << "circles     " << circlePairs << " pairs, " << batchedCircles << " in " << circleBatches << " batches (fill "
+              << (circleBatches ? (double)batchedCircles/circleBatches : 0.0) << ")" << std::endl;
+    std::cout << "islands     " << (steps ? (double)islands/steps : 0.0) << " per step (largest " << largestIsland << " contacts)" << std::endl;
+    std::cout << "sleeping    " << phyEngine.stats.sleepingBodies << " bodies at the end (" << woken << " woken)" << std::endl;
+
+    if(trace)
+    {
+        std::ofstream file(tracePath);
+        trace->writeChromeTrace(file);
+        std::cout << "trace       " << tracePath << " (" << trace->recorded() << " events)" << std::endl;
+        delete trace;
+    }
+
+    return 0;
+}